@@ -42,6 +42,7 @@
 #include "ns3/mmwave-vehicular-helper.h"
 #include "ns3/mmwave-vehicular-net-device.h"
 #include "ns3/mmwave-vehicular-propagation-loss-model.h"
+#include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
 #include "ns3/mobility-module.h"
 #include "ns3/netanim-module.h"
 #include "ns3/rain-snow-attenuation.h"
@@ -394,6 +395,10 @@ int main(int argc, char *argv[]) {
     if (vehicleSpeedControl)
       vehicleSpeedControl->StopApplicationNow();
 
+    // forget the channel condition and the shadowing of the links of the
+    // vehicle, the node may be reused by another vehicle
+    MmWaveVehicularHelper::RemoveNodeLinkStates(exNode);
+
     // set position outside communication range in SUMO
     Ptr<ConstantPositionMobilityModel> mob =
         exNode->GetObject<ConstantPositionMobilityModel>();
@@ -405,10 +410,22 @@ int main(int argc, char *argv[]) {
   sumoClient->SumoSetup(setupNew5GNode, shutdown5GNode);
   computePathLoss(devs1, devs2, stepTime);
   
+  // the fast fading model counts the channel expirations, each of which
+  // used to require a scheduled event
+  Ptr<MmWaveVehicularSpectrumPropagationLossModel> fading =
+      DynamicCast<MmWaveVehicularSpectrumPropagationLossModel>(DynamicCast<MmWaveVehicularNetDevice>(devs1.Get(0))
+                                                                   ->GetPhy()
+                                                                   ->GetSpectrumPhy()
+                                                                   ->GetSpectrumChannel()
+                                                                   ->GetSpectrumPropagationLossModel());
+
   for(int i=0; i<5; i++){
   Simulator::Stop(simulationTime);
   // AnimationInterface anim ("animation.xml");
   Simulator::Run();
+  if (fading) {
+    std::cout << "Channel expirations (scheduler events saved): " << fading->GetNumExpiredChannels() << std::endl;
+  }
   Simulator::Destroy();
   }
   
@@ -430,8 +447,17 @@ void computePathLoss(NetDeviceContainer devs1, NetDeviceContainer devs2, double
   Vector3D pos1 = mobileNode2->GetPosition();
   std::cout << "\n The Distance between Group1 0th and Groups1 1th is: " << pos-pos1 << std::endl;
   
-  pathLossVal = pathloss->GetLoss(mobileNode1, mobileNode2);
+  // the loss from the 0th node of group 1 to all the nodes of group 2 in one
+  // call; the trace keeps the loss to the 0th node of group 2
+  std::vector<Ptr<MobilityModel>> receivers;
+  for (uint32_t i = 0; i < devs2.GetN(); i++)
+    receivers.push_back(devs2.Get(i)->GetNode()->GetObject<MobilityModel>());
+  std::vector<double> losses(receivers.size());
+  pathloss->GetLoss(mobileNode1, receivers, losses.data());
+  pathLossVal = losses[0];
   std::cout << "\n The value of the path loss is: " << pathLossVal << std::endl;
+  for (uint32_t i = 1; i < losses.size(); i++)
+    std::cout << " The value of the path loss to the " << i << "th node of group 2 is: " << losses[i] << std::endl;
   
   double distance3D = mobileNode2->GetDistanceFrom(mobileNode1);                              // Distance 계산
   double weatherAtten = pathloss->GetWeatherAttenuation(distance3D, pos.z, pos1.z);           // Weather Atten. 값 계산
@@ -365,6 +365,10 @@ int main(int argc, char *argv[]) {
     if (vehicleSpeedControl)
       vehicleSpeedControl->StopApplicationNow();
 
+    // forget the channel condition and the shadowing of the links of the
+    // vehicle, the node may be reused by another vehicle
+    MmWaveVehicularHelper::RemoveNodeLinkStates(exNode);
+
     // set position outside communication range in SUMO
     Ptr<ConstantPositionMobilityModel> mob =
         exNode->GetObject<ConstantPositionMobilityModel>();
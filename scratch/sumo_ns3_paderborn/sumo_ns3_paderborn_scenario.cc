@@ -142,6 +142,10 @@ int main(int argc, char *argv[]) {
         exNode->GetApplication(0)->GetObject<VehicleSpeedControl>();
     if (vehicleSpeedControl)
       vehicleSpeedControl->StopApplicationNow();
+
+    // forget the channel condition and the shadowing of the links of the
+    // vehicle, which are not used anymore
+    MmWaveVehicularHelper::RemoveNodeLinkStates(exNode);
   };
 
   // start traci client with given function pointers
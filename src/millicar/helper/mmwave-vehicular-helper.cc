@@ -25,6 +25,7 @@
 #include "ns3/single-model-spectrum-channel.h"
 #include "ns3/mmwave-vehicular-antenna-array-model.h"
 #include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "ns3/mmwave-vehicular-propagation-loss-model.h"
 #include "ns3/pointer.h"
 #include "ns3/config.h"
 
@@ -330,7 +331,6 @@ MmWaveVehicularHelper::newPairingSystem(NetDeviceContainer devices, uint8_t id)
   di->GetMac ()->SetSfAllocationInfo (pattern); // this is called ONCE for each NetDevice
   for (NetDeviceContainer::Iterator j = devices.Begin (); j != i; ++j)
   {
-    std::cout<<"I am here"<<std::endl;
       Ptr<MmWaveVehicularNetDevice> dj = DynamicCast<MmWaveVehicularNetDevice> (*j);
       Ptr<Node> jNode = dj->GetNode ();
         Ptr<Ipv4> jNodeIpv4 = jNode->GetObject<Ipv4> ();
@@ -350,12 +350,10 @@ MmWaveVehicularHelper::newPairingSystem(NetDeviceContainer devices, uint8_t id)
         // bearer activation by creating a logical channel between the two devices
         NS_LOG_DEBUG("Activation of bearer between " << diAddr << " and " << djAddr);
         NS_LOG_DEBUG("Bearer ID: " << uint32_t(bearerId) << " - Associate RNTI " << di->GetMac ()->GetRnti () << " to " << dj->GetMac ()->GetRnti ());
-        std::cout<< "Bearer ID: " << uint32_t(bearerId) << " - Associate RNTI " << unsigned(di->GetMac ()->GetRnti ()) << " to " << unsigned(dj->GetMac ()->GetRnti ()) <<std::endl;
 
         di->ActivateBearer(bearerId, dj->GetMac ()->GetRnti (), djAddr);
         dj->ActivateBearer(bearerId, di->GetMac ()->GetRnti (), diAddr);
         bearerId++;
-        std::cout<<"The value of the bearer is: "<< unsigned(bearerId)<<std::endl;
     }
 
     return bearerId;
@@ -465,5 +463,26 @@ MmWaveVehicularHelper::GetSchedulingPatternOptionType () const
   return m_schedulingOpt;
 }
 
+void
+MmWaveVehicularHelper::RemoveNodeLinkStates (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (node);
+  for (uint32_t i = 0; i < node->GetNDevices (); i++)
+  {
+    Ptr<MmWaveVehicularNetDevice> device = DynamicCast<MmWaveVehicularNetDevice> (node->GetDevice (i));
+    if (device == 0)
+    {
+      continue;
+    }
+    PointerValue plm;
+    device->GetPhy ()->GetSpectrumPhy ()->GetSpectrumChannel ()->GetAttribute ("PropagationLossModel", plm);
+    Ptr<MmWaveVehicularPropagationLossModel> pathloss = DynamicCast<MmWaveVehicularPropagationLossModel> (plm.Get<PropagationLossModel> ());
+    if (pathloss != 0)
+    {
+      pathloss->RemoveNode (node->GetId ());
+    }
+  }
+}
+
 } // namespace millicar
 } // namespace ns3
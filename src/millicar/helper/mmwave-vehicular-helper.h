@@ -130,6 +130,14 @@ public:
   */
   SchedulingPatternOption_t GetSchedulingPatternOptionType () const;
 
+  /**
+   * Forget the channel condition and the shadowing of all the links of a
+   * node in the MmWaveVehicularPropagationLossModel of its channels, e.g.,
+   * when the corresponding vehicle leaves the simulation
+   * \param node the node
+   */
+  static void RemoveNodeLinkStates (Ptr<Node> node);
+
 protected:
   // inherited from Object
   virtual void DoInitialize (void) override;
@@ -0,0 +1,299 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef CHANNEL_TENSOR_H_
+#define CHANNEL_TENSOR_H_
+
+#include <ns3/assert.h>
+#include <ns3/fatal-error.h>
+#include <algorithm>
+#include <cstdlib>
+#include <stdint.h>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * Dense three dimensional array, stored in a single aligned allocation.
+ *
+ * The elements are stored either in row-major order, i.e., the last index
+ * varies fastest, as in H[u][s][n], or in column-major order, i.e., the first
+ * index varies fastest. The accessors check the indices only when the
+ * asserts are enabled. Resize and Clear keep the allocated memory, therefore
+ * a tensor which is refilled with the same or a smaller size, e.g., by a
+ * channel update, does not allocate again.
+ *
+ * \tparam T the type of the elements, which must be trivially copyable
+ */
+template <typename T>
+class Tensor3D
+{
+public:
+  /**
+   * Storage order of the elements
+   */
+  enum Layout
+  {
+    ROW_MAJOR,    //!< the last index varies fastest
+    COLUMN_MAJOR  //!< the first index varies fastest
+  };
+
+  static const size_t ALIGNMENT = 64; //!< alignment of the storage, in bytes
+
+  /**
+   * Create an empty tensor
+   *
+   * \param layout the storage order
+   */
+  explicit Tensor3D (Layout layout = ROW_MAJOR)
+    : m_data (0),
+      m_capacity (0),
+      m_layout (layout)
+  {
+    m_dim[0] = m_dim[1] = m_dim[2] = 0;
+    m_stride[0] = m_stride[1] = m_stride[2] = 0;
+  }
+
+  /**
+   * Copy constructor
+   *
+   * \param other the tensor to copy
+   */
+  Tensor3D (const Tensor3D &other)
+    : m_data (0),
+      m_capacity (0),
+      m_layout (other.m_layout)
+  {
+    m_dim[0] = m_dim[1] = m_dim[2] = 0;
+    m_stride[0] = m_stride[1] = m_stride[2] = 0;
+    *this = other;
+  }
+
+  ~Tensor3D ()
+  {
+    free (m_data);
+  }
+
+  /**
+   * Copy the dimensions, the layout and the elements of another tensor
+   *
+   * \param other the tensor to copy
+   * \returns this tensor
+   */
+  Tensor3D &
+  operator = (const Tensor3D &other)
+  {
+    if (this != &other)
+      {
+        m_layout = other.m_layout;
+        Resize (other.m_dim[0], other.m_dim[1], other.m_dim[2]);
+        std::copy (other.m_data, other.m_data + other.GetSize (), m_data);
+      }
+    return *this;
+  }
+
+  /**
+   * Exchange the content of two tensors, without copying the elements
+   *
+   * \param other the other tensor
+   */
+  void
+  Swap (Tensor3D &other)
+  {
+    std::swap (m_data, other.m_data);
+    std::swap (m_capacity, other.m_capacity);
+    std::swap (m_layout, other.m_layout);
+    for (uint32_t i = 0; i < 3; i++)
+      {
+        std::swap (m_dim[i], other.m_dim[i]);
+        std::swap (m_stride[i], other.m_stride[i]);
+      }
+  }
+
+  /**
+   * Change the dimensions. The memory is allocated again only if the new
+   * size exceeds the capacity, and the values of the elements are not
+   * preserved.
+   *
+   * \param d0 the size of the first dimension
+   * \param d1 the size of the second dimension
+   * \param d2 the size of the third dimension
+   */
+  void
+  Resize (uint32_t d0, uint32_t d1, uint32_t d2)
+  {
+    size_t size = static_cast<size_t> (d0) * d1 * d2;
+    if (size > m_capacity)
+      {
+        free (m_data);
+        m_data = 0;
+        void *ptr = 0;
+        if (posix_memalign (&ptr, ALIGNMENT, size * sizeof (T)) != 0)
+          {
+            NS_FATAL_ERROR ("Unable to allocate a tensor of " << size << " elements");
+          }
+        m_data = static_cast<T *> (ptr);
+        m_capacity = size;
+      }
+
+    m_dim[0] = d0;
+    m_dim[1] = d1;
+    m_dim[2] = d2;
+    if (m_layout == ROW_MAJOR)
+      {
+        m_stride[2] = 1;
+        m_stride[1] = d2;
+        m_stride[0] = static_cast<size_t> (d1) * d2;
+      }
+    else
+      {
+        m_stride[0] = 1;
+        m_stride[1] = d0;
+        m_stride[2] = static_cast<size_t> (d0) * d1;
+      }
+  }
+
+  /**
+   * Remove all the elements, keeping the allocated memory
+   */
+  void
+  Clear (void)
+  {
+    Resize (0, 0, 0);
+  }
+
+  /**
+   * Set all the elements to the same value
+   *
+   * \param value the value
+   */
+  void
+  Fill (const T &value)
+  {
+    std::fill (m_data, m_data + GetSize (), value);
+  }
+
+  /**
+   * \param i the index of the first dimension
+   * \param j the index of the second dimension
+   * \param k the index of the third dimension
+   * \returns a reference to the element
+   */
+  T &
+  operator () (uint32_t i, uint32_t j, uint32_t k)
+  {
+    NS_ASSERT_MSG (i < m_dim[0] && j < m_dim[1] && k < m_dim[2], "Index out of range");
+    return m_data[i * m_stride[0] + j * m_stride[1] + k * m_stride[2]];
+  }
+
+  /**
+   * \param i the index of the first dimension
+   * \param j the index of the second dimension
+   * \param k the index of the third dimension
+   * \returns a const reference to the element
+   */
+  const T &
+  operator () (uint32_t i, uint32_t j, uint32_t k) const
+  {
+    NS_ASSERT_MSG (i < m_dim[0] && j < m_dim[1] && k < m_dim[2], "Index out of range");
+    return m_data[i * m_stride[0] + j * m_stride[1] + k * m_stride[2]];
+  }
+
+  /**
+   * \param dim the dimension, from 0 to 2
+   * \returns the size of the dimension
+   */
+  uint32_t
+  GetDim (uint32_t dim) const
+  {
+    NS_ASSERT (dim < 3);
+    return m_dim[dim];
+  }
+
+  /**
+   * \param dim the dimension, from 0 to 2
+   * \returns the distance, in elements, between two consecutive indices of
+   *          the dimension
+   */
+  size_t
+  GetStride (uint32_t dim) const
+  {
+    NS_ASSERT (dim < 3);
+    return m_stride[dim];
+  }
+
+  /**
+   * \returns the storage order
+   */
+  Layout
+  GetLayout (void) const
+  {
+    return m_layout;
+  }
+
+  /**
+   * \returns the number of elements
+   */
+  size_t
+  GetSize (void) const
+  {
+    return static_cast<size_t> (m_dim[0]) * m_dim[1] * m_dim[2];
+  }
+
+  /**
+   * \returns true if the tensor has no elements
+   */
+  bool
+  IsEmpty (void) const
+  {
+    return GetSize () == 0;
+  }
+
+  /**
+   * \returns the storage of the elements
+   */
+  T *
+  GetData (void)
+  {
+    return m_data;
+  }
+
+  /**
+   * \returns the storage of the elements
+   */
+  const T *
+  GetData (void) const
+  {
+    return m_data;
+  }
+
+private:
+  T *m_data; //!< the aligned storage
+  size_t m_capacity; //!< number of elements which fit in the storage
+  Layout m_layout; //!< the storage order
+  uint32_t m_dim[3]; //!< size of each dimension
+  size_t m_stride[3]; //!< stride of each dimension, in elements
+};
+
+} // namespace millicar
+
+} // namespace ns3
+
+#endif
@@ -0,0 +1,280 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "link-state-store.h"
+#include <ns3/log.h>
+#include <ns3/assert.h>
+#include <algorithm>
+#include <limits>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("LinkStateStore");
+
+const uint32_t LinkStateStore::INVALID_SLOT = std::numeric_limits<uint32_t>::max ();
+
+static const uint64_t g_emptyKey = std::numeric_limits<uint64_t>::max (); // never used slot
+static const uint64_t g_removedKey = g_emptyKey - 1; // slot of a removed link
+static const uint32_t g_initialCapacity = 64; // must be a power of two
+static const double g_maxLoad = 0.7; // max fraction of used (live or removed) slots
+
+LinkStateStore::LinkStateStore ()
+  : m_size (0),
+    m_tombstones (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint64_t
+LinkStateStore::GetKey (uint32_t idA, uint32_t idB)
+{
+  if (idA > idB)
+    {
+      std::swap (idA, idB);
+    }
+  return (static_cast<uint64_t> (idA) << 32) | idB;
+}
+
+uint32_t
+LinkStateStore::GetHomeSlot (uint64_t key) const
+{
+  // Fibonacci hashing, the capacity is a power of two
+  uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+  return static_cast<uint32_t> (hash >> 32) & (m_keys.size () - 1);
+}
+
+uint32_t
+LinkStateStore::Find (uint64_t key) const
+{
+  if (m_keys.empty ())
+    {
+      return INVALID_SLOT;
+    }
+
+  uint32_t mask = m_keys.size () - 1;
+  for (uint32_t slot = GetHomeSlot (key); ; slot = (slot + 1) & mask)
+    {
+      if (m_keys[slot] == key)
+        {
+          return slot;
+        }
+      if (m_keys[slot] == g_emptyKey)
+        {
+          return INVALID_SLOT;
+        }
+    }
+}
+
+uint32_t
+LinkStateStore::Insert (uint64_t key, char condition, double shadowing, Time now)
+{
+  NS_ASSERT_MSG (Find (key) == INVALID_SLOT, "The link is already stored");
+
+  if (m_keys.empty ())
+    {
+      Rehash (g_initialCapacity);
+    }
+  else if (m_size + m_tombstones + 1 > g_maxLoad * m_keys.size ())
+    {
+      // grow only if the live links need it, otherwise just reclaim the
+      // removed slots
+      uint32_t capacity = m_keys.size ();
+      if (m_size + 1 > g_maxLoad * capacity / 2)
+        {
+          capacity *= 2;
+        }
+      Rehash (capacity);
+    }
+
+  uint32_t mask = m_keys.size () - 1;
+  uint32_t slot = GetHomeSlot (key);
+  while (m_keys[slot] != g_emptyKey && m_keys[slot] != g_removedKey)
+    {
+      slot = (slot + 1) & mask;
+    }
+
+  if (m_keys[slot] == g_removedKey)
+    {
+      m_tombstones--;
+    }
+  m_keys[slot] = key;
+  m_condition[slot] = condition;
+  m_shadowing[slot] = shadowing;
+  m_position[slot] = Vector ();
+  m_lastUsed[slot] = now.GetTimeStep ();
+  m_size++;
+  return slot;
+}
+
+char
+LinkStateStore::GetCondition (uint32_t slot) const
+{
+  return m_condition[slot];
+}
+
+double
+LinkStateStore::GetShadowing (uint32_t slot) const
+{
+  return m_shadowing[slot];
+}
+
+const Vector &
+LinkStateStore::GetPosition (uint32_t slot) const
+{
+  return m_position[slot];
+}
+
+void
+LinkStateStore::Update (uint32_t slot, double shadowing, const Vector &position, Time now)
+{
+  m_shadowing[slot] = shadowing;
+  m_position[slot] = position;
+  m_lastUsed[slot] = now.GetTimeStep ();
+}
+
+void
+LinkStateStore::Touch (uint32_t slot, Time now)
+{
+  m_lastUsed[slot] = now.GetTimeStep ();
+}
+
+void
+LinkStateStore::Erase (uint32_t slot)
+{
+  m_keys[slot] = g_removedKey;
+  m_size--;
+  m_tombstones++;
+}
+
+bool
+LinkStateStore::Remove (uint64_t key)
+{
+  uint32_t slot = Find (key);
+  if (slot == INVALID_SLOT)
+    {
+      return false;
+    }
+  Erase (slot);
+  return true;
+}
+
+uint32_t
+LinkStateStore::RemoveNode (uint32_t nodeId)
+{
+  NS_LOG_FUNCTION (this << nodeId);
+
+  uint32_t removed = 0;
+  for (uint32_t slot = 0; slot < m_keys.size (); ++slot)
+    {
+      uint64_t key = m_keys[slot];
+      if (key == g_emptyKey || key == g_removedKey)
+        {
+          continue;
+        }
+      if (static_cast<uint32_t> (key >> 32) == nodeId || static_cast<uint32_t> (key) == nodeId)
+        {
+          Erase (slot);
+          removed++;
+        }
+    }
+  return removed;
+}
+
+uint32_t
+LinkStateStore::RemoveIdle (Time limit)
+{
+  NS_LOG_FUNCTION (this << limit);
+
+  int64_t limitStep = limit.GetTimeStep ();
+  uint32_t removed = 0;
+  for (uint32_t slot = 0; slot < m_keys.size (); ++slot)
+    {
+      uint64_t key = m_keys[slot];
+      if (key != g_emptyKey && key != g_removedKey && m_lastUsed[slot] < limitStep)
+        {
+          Erase (slot);
+          removed++;
+        }
+    }
+  NS_LOG_DEBUG ("Removed " << removed << " idle links, " << m_size << " left");
+  return removed;
+}
+
+uint32_t
+LinkStateStore::GetSize (void) const
+{
+  return m_size;
+}
+
+void
+LinkStateStore::Clear (void)
+{
+  m_keys.clear ();
+  m_condition.clear ();
+  m_shadowing.clear ();
+  m_position.clear ();
+  m_lastUsed.clear ();
+  m_size = 0;
+  m_tombstones = 0;
+}
+
+void
+LinkStateStore::Rehash (uint32_t capacity)
+{
+  NS_LOG_FUNCTION (this << capacity);
+  NS_ASSERT_MSG ((capacity & (capacity - 1)) == 0, "The capacity must be a power of two");
+
+  std::vector<uint64_t> keys (capacity, g_emptyKey);
+  std::vector<char> condition (capacity);
+  std::vector<double> shadowing (capacity);
+  std::vector<Vector> position (capacity);
+  std::vector<int64_t> lastUsed (capacity);
+
+  m_keys.swap (keys);
+  m_condition.swap (condition);
+  m_shadowing.swap (shadowing);
+  m_position.swap (position);
+  m_lastUsed.swap (lastUsed);
+  m_tombstones = 0;
+
+  uint32_t mask = capacity - 1;
+  for (uint32_t old = 0; old < keys.size (); ++old)
+    {
+      if (keys[old] == g_emptyKey || keys[old] == g_removedKey)
+        {
+          continue;
+        }
+      uint32_t slot = GetHomeSlot (keys[old]);
+      while (m_keys[slot] != g_emptyKey)
+        {
+          slot = (slot + 1) & mask;
+        }
+      m_keys[slot] = keys[old];
+      m_condition[slot] = condition[old];
+      m_shadowing[slot] = shadowing[old];
+      m_position[slot] = position[old];
+      m_lastUsed[slot] = lastUsed[old];
+    }
+}
+
+} // namespace millicar
+
+} // namespace ns3
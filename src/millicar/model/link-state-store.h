@@ -0,0 +1,177 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef LINK_STATE_STORE_H_
+#define LINK_STATE_STORE_H_
+
+#include <ns3/vector.h>
+#include <ns3/nstime.h>
+#include <vector>
+#include <stdint.h>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * Per-link state of MmWaveVehicularPropagationLossModel.
+ *
+ * The links are symmetric, hence every link is stored once under the
+ * canonical key (min node id, max node id). The entries are kept in an
+ * open-addressing hash table with linear probing; the state of each link
+ * (channel condition, shadowing, position used for the shadowing
+ * correlation and time of the last update) is kept in separate arrays
+ * indexed by the slot returned by Find and Insert. The slots are stable
+ * until the next call to Insert, Remove, RemoveNode or RemoveIdle.
+ */
+class LinkStateStore
+{
+public:
+  static const uint32_t INVALID_SLOT; //!< returned by Find if the link is unknown
+
+  LinkStateStore ();
+
+  /**
+   * \param idA the id of the first node
+   * \param idB the id of the second node
+   * \returns the key of the link, which does not depend on the order of the nodes
+   */
+  static uint64_t GetKey (uint32_t idA, uint32_t idB);
+
+  /**
+   * \param key the key of the link
+   * \returns the slot of the link, or INVALID_SLOT if it is not stored
+   */
+  uint32_t Find (uint64_t key) const;
+
+  /**
+   * Add a new link. The key must not be already stored.
+   *
+   * \param key the key of the link
+   * \param condition the channel condition of the link
+   * \param shadowing the initial shadowing value
+   * \param now the current simulation time
+   * \returns the slot of the new link
+   */
+  uint32_t Insert (uint64_t key, char condition, double shadowing, Time now);
+
+  /**
+   * \param slot the slot of the link
+   * \returns the channel condition
+   */
+  char GetCondition (uint32_t slot) const;
+
+  /**
+   * \param slot the slot of the link
+   * \returns the last shadowing value
+   */
+  double GetShadowing (uint32_t slot) const;
+
+  /**
+   * \param slot the slot of the link
+   * \returns the position stored together with the last shadowing value
+   */
+  const Vector & GetPosition (uint32_t slot) const;
+
+  /**
+   * Store the new shadowing value of a link
+   *
+   * \param slot the slot of the link
+   * \param shadowing the shadowing value
+   * \param position the position of the reference device
+   * \param now the current simulation time
+   */
+  void Update (uint32_t slot, double shadowing, const Vector &position, Time now);
+
+  /**
+   * Mark a link as used without changing its state
+   *
+   * \param slot the slot of the link
+   * \param now the current simulation time
+   */
+  void Touch (uint32_t slot, Time now);
+
+  /**
+   * \param key the key of the link to remove
+   * \returns true if the link was stored
+   */
+  bool Remove (uint64_t key);
+
+  /**
+   * Remove all the links of a node, e.g., when the vehicle leaves the
+   * simulation
+   *
+   * \param nodeId the id of the node
+   * \returns the number of removed links
+   */
+  uint32_t RemoveNode (uint32_t nodeId);
+
+  /**
+   * Remove the links which have not been used since a given time
+   *
+   * \param limit the links last used before this time are removed
+   * \returns the number of removed links
+   */
+  uint32_t RemoveIdle (Time limit);
+
+  /**
+   * \returns the number of stored links
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * Remove all the links
+   */
+  void Clear (void);
+
+private:
+  /**
+   * \param key the key of the link
+   * \returns the first slot to probe
+   */
+  uint32_t GetHomeSlot (uint64_t key) const;
+
+  /**
+   * Empty a slot
+   *
+   * \param slot the slot to empty
+   */
+  void Erase (uint32_t slot);
+
+  /**
+   * Resize the table to a given capacity and reinsert all the live links
+   *
+   * \param capacity the new capacity, must be a power of two
+   */
+  void Rehash (uint32_t capacity);
+
+  std::vector<uint64_t> m_keys; //!< key of each slot, or one of the reserved markers
+  std::vector<char> m_condition; //!< channel condition of each slot
+  std::vector<double> m_shadowing; //!< last shadowing value of each slot
+  std::vector<Vector> m_position; //!< position used for the shadowing correlation
+  std::vector<int64_t> m_lastUsed; //!< time step of the last access to each slot
+  uint32_t m_size; //!< number of live links
+  uint32_t m_tombstones; //!< number of removed slots not yet reclaimed
+};
+
+} // namespace millicar
+
+} // namespace ns3
+
+#endif
@@ -60,6 +60,7 @@ MmWaveSidelinkPhy::MmWaveSidelinkPhy ()
 }
 
 MmWaveSidelinkPhy::MmWaveSidelinkPhy (Ptr<MmWaveSidelinkSpectrumPhy> spectrumPhy, Ptr<mmwave::MmWavePhyMacCommon> confParams)
+  : m_txPsdBandwidth (0)
 {
   NS_LOG_FUNCTION (this);
   m_sidelinkSpectrumPhy = spectrumPhy;
@@ -119,12 +120,14 @@ MmWaveSidelinkPhy::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
   delete m_phySapProvider;
+  m_txPsdCache.clear ();
 }
 
 void
 MmWaveSidelinkPhy::SetTxPower (double power)
 {
   m_txPower = power;
+  m_txPsdCache.clear ();
 }
 double
 MmWaveSidelinkPhy::GetTxPower () const
@@ -232,9 +235,8 @@ MmWaveSidelinkPhy::SlData (Ptr<PacketBurst> pb, mmwave::TtiAllocInfo info)
 {
   NS_LOG_FUNCTION (this);
 
-  // create the tx PSD
-  //TODO do we need to create a new psd at each TTI?
-  std::vector<int> subChannelsForTx = SetSubChannelsForTransmission ();
+  // set the tx PSD
+  const std::vector<int> &subChannelsForTx = SetSubChannelsForTransmission ();
 
   // compute the tx start time (IndexOfTheFirstSymbol * SymbolDuration)
   Time startTime = info.m_dci.m_symStart * m_phyMacConfig->GetSymbolPeriod ();
@@ -270,23 +272,41 @@ MmWaveSidelinkPhy::SendDataChannels (Ptr<PacketBurst> pb,
   m_sidelinkSpectrumPhy->StartTxDataFrames (pb, duration, info.m_dci.m_mcs, info.m_dci.m_tbSize, info.m_dci.m_numSym, info.m_dci.m_rnti, info.m_rnti, rbBitmap);
 }
 
-std::vector<int>
+const std::vector<int>&
 MmWaveSidelinkPhy::SetSubChannelsForTransmission ()
   {
     // create the transmission mask, use all the available subchannels
-    std::vector<int> subChannelsForTx (m_phyMacConfig->GetNumChunks ());
-    for (uint32_t i = 0; i < subChannelsForTx.size (); i++)
+    if (m_subChannelsForTx.size () != m_phyMacConfig->GetNumChunks ())
     {
-      subChannelsForTx.at(i) = i;
+      m_subChannelsForTx.resize (m_phyMacConfig->GetNumChunks ());
+      for (uint32_t i = 0; i < m_subChannelsForTx.size (); i++)
+      {
+        m_subChannelsForTx.at(i) = i;
+      }
     }
 
-    // create the tx PSD
-    Ptr<SpectrumValue> txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (m_phyMacConfig, m_txPower, subChannelsForTx);
+    // the cached PSDs are no longer valid if the numerology changed
+    Ptr<const SpectrumModel> model = mmwave::MmWaveSpectrumValueHelper::GetSpectrumModel (m_phyMacConfig);
+    if (model != m_txPsdModel || m_phyMacConfig->GetBandwidth () != m_txPsdBandwidth)
+    {
+      m_txPsdCache.clear ();
+      m_txPsdModel = model;
+      m_txPsdBandwidth = m_phyMacConfig->GetBandwidth ();
+    }
+
+    // create the tx PSD, if it is the first time this mask is used
+    std::map<std::vector<int>, Ptr<const SpectrumValue> >::iterator it = m_txPsdCache.find (m_subChannelsForTx);
+    if (it == m_txPsdCache.end ())
+    {
+      NS_LOG_DEBUG ("Create the tx PSD with power " << m_txPower << " dBm");
+      Ptr<const SpectrumValue> txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (m_phyMacConfig, m_txPower, m_subChannelsForTx);
+      it = m_txPsdCache.insert (std::make_pair (m_subChannelsForTx, txPsd)).first;
+    }
 
     // set the tx PSD in the spectrum phy
-    m_sidelinkSpectrumPhy->SetTxPowerSpectralDensity (txPsd);
+    m_sidelinkSpectrumPhy->SetTxPowerSpectralDensity (it->second);
 
-    return subChannelsForTx;
+    return m_subChannelsForTx;
   }
 
 mmwave::SfnSf
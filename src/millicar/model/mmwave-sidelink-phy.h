@@ -167,11 +167,12 @@ private:
   uint8_t SlData (Ptr<PacketBurst> pb, mmwave::TtiAllocInfo info);
 
   /**
-   * Set the transmission mask and creates the power spectral density for the
-   * transmission
+   * Set the transmission mask and the power spectral density for the
+   * transmission. The PSD is created only the first time a mask is used with
+   * the current tx power and numerology, then it is shared.
    * \return mask indicating the suchannels used for the transmission
    */
-  std::vector<int> SetSubChannelsForTransmission ();
+  const std::vector<int>& SetSubChannelsForTransmission ();
 
   /**
    * Send the packet burts
@@ -204,6 +205,10 @@ private:
   typedef std::pair<Ptr<PacketBurst>, mmwave::TtiAllocInfo> PhyBufferEntry; //!< type of the phy buffer entries
   std::list<PhyBufferEntry> m_phyBuffer; //!< buffer of transport blocks to send in the current slot
   std::map<uint64_t, Ptr<NetDevice>> m_deviceMap; //!< map containing the <rnti, device> pairs of the nodes we want to communicate with
+  std::vector<int> m_subChannelsForTx; //!< the transmission mask, with all the available subchannels
+  std::map<std::vector<int>, Ptr<const SpectrumValue> > m_txPsdCache; //!< the tx PSD for each transmission mask, with the current tx power
+  Ptr<const SpectrumModel> m_txPsdModel; //!< the spectrum model of the cached tx PSDs
+  double m_txPsdBandwidth; //!< the bandwidth of the cached tx PSDs, in Hz
 };
 
 class MacSidelinkMemberPhySapProvider : public MmWaveSidelinkPhySapProvider
@@ -77,7 +77,10 @@ static const double EffectiveCodingRate[29] = {
 
 MmWaveSidelinkSpectrumPhy::MmWaveSidelinkSpectrumPhy ()
   : m_state (IDLE),
-    m_componentCarrierId (0)
+    m_componentCarrierId (0),
+    m_beamformingGeneration (0),
+    m_beamformingHits (0),
+    m_beamformingMisses (0)
 {
   m_interferenceData = CreateObject<mmwave::mmWaveInterference> ();
   m_random = CreateObject<UniformRandomVariable> ();
@@ -102,6 +105,11 @@ MmWaveSidelinkSpectrumPhy::GetTypeId (void)
                    BooleanValue (true),
                    MakeBooleanAccessor (&MmWaveSidelinkSpectrumPhy::m_dataErrorModelEnabled),
                    MakeBooleanChecker ())
+    .AddTraceSource ("ConfigureBeamforming",
+                     "Fired when the beamforming is configured towards a device, "
+                     "tells whether the current beam was reused or computed",
+                     MakeTraceSourceAccessor (&MmWaveSidelinkSpectrumPhy::m_beamformingTrace),
+                     "ns3::millicar::MmWaveSidelinkSpectrumPhy::BeamformingTracedCallback")
   ;
 
   return tid;
@@ -109,7 +117,7 @@ MmWaveSidelinkSpectrumPhy::GetTypeId (void)
 void
 MmWaveSidelinkSpectrumPhy::DoDispose ()
 {
-
+  m_beamformingDevice = 0;
 }
 
 void
@@ -197,7 +205,7 @@ MmWaveSidelinkSpectrumPhy::SetNoisePowerSpectralDensity (Ptr<const SpectrumValue
 }
 
 void
-MmWaveSidelinkSpectrumPhy::SetTxPowerSpectralDensity (Ptr<SpectrumValue> TxPsd)
+MmWaveSidelinkSpectrumPhy::SetTxPowerSpectralDensity (Ptr<const SpectrumValue> TxPsd)
 {
   m_txPsd = TxPsd;
 }
@@ -480,7 +488,9 @@ MmWaveSidelinkSpectrumPhy::StartTxDataFrames (Ptr<PacketBurst> pb,
         Ptr<MmWaveSidelinkSpectrumSignalParameters> txParams = Create<MmWaveSidelinkSpectrumSignalParameters> ();
         txParams->duration = duration;
         txParams->txPhy = this->GetObject<SpectrumPhy> ();
-        txParams->psd = m_txPsd;
+        // the channel copies the PSD before applying the losses, therefore
+        // the shared PSD is not modified
+        txParams->psd = ConstCast<SpectrumValue> (m_txPsd);
         txParams->packetBurst = pb;
         //txParams->ctrlMsgList = ctrlMsgList;
         txParams->txAntenna = m_antenna;
@@ -590,12 +600,51 @@ MmWaveSidelinkSpectrumPhy::ConfigureBeamforming (Ptr<NetDevice> dev)
   Ptr<MmWaveVehicularAntennaArrayModel> antennaArray = DynamicCast<MmWaveVehicularAntennaArrayModel> (m_antenna);
   if (antennaArray)
   {
-    //TODO consider to update this in order to not recompute the beamforming
-    // vectors each time
-    antennaArray->SetBeamformingVectorPanelDevices (m_device, dev);
+    // the beam depends only on the positions of the two devices, which
+    // change only when the mobility is updated (e.g., every SUMO step)
+    Vector position = m_device->GetNode ()->GetObject<MobilityModel> ()->GetPosition ();
+    Vector otherPosition = dev->GetNode ()->GetObject<MobilityModel> ()->GetPosition ();
+
+    // the beam may also have been changed through the antenna, e.g., by
+    // another device which shares it
+    bool hit = dev == m_beamformingDevice
+      && !antennaArray->IsOmniTx ()
+      && antennaArray->GetBeamformingGeneration () == m_beamformingGeneration
+      && position.x == m_beamformingPosition.x && position.y == m_beamformingPosition.y
+      && position.z == m_beamformingPosition.z
+      && otherPosition.x == m_beamformingOtherPosition.x && otherPosition.y == m_beamformingOtherPosition.y
+      && otherPosition.z == m_beamformingOtherPosition.z;
+
+    if (hit)
+    {
+      m_beamformingHits++;
+    }
+    else
+    {
+      antennaArray->SetBeamformingVectorPanelDevices (m_device, dev);
+      m_beamformingDevice = dev;
+      m_beamformingPosition = position;
+      m_beamformingOtherPosition = otherPosition;
+      m_beamformingGeneration = antennaArray->GetBeamformingGeneration ();
+      m_beamformingMisses++;
+    }
+    NS_LOG_DEBUG ("Beamforming towards " << dev << " hit " << hit);
+    m_beamformingTrace (dev, hit);
   }
 }
 
+uint64_t
+MmWaveSidelinkSpectrumPhy::GetBeamformingHits () const
+{
+  return m_beamformingHits;
+}
+
+uint64_t
+MmWaveSidelinkSpectrumPhy::GetBeamformingMisses () const
+{
+  return m_beamformingMisses;
+}
+
 }
 
 }
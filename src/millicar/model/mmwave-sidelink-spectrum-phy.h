@@ -40,6 +40,7 @@
 #include "ns3/random-variable-stream.h"
 #include "ns3/mmwave-interference.h"
 #include "ns3/mmwave-control-messages.h"
+#include <ns3/traced-callback.h>
 
 namespace ns3 {
 
@@ -170,7 +171,7 @@ public:
   void SetAntenna (Ptr<AntennaModel> a);
 
   void SetNoisePowerSpectralDensity (Ptr<const SpectrumValue> noisePsd);
-  void SetTxPowerSpectralDensity (Ptr<SpectrumValue> TxPsd);
+  void SetTxPowerSpectralDensity (Ptr<const SpectrumValue> TxPsd);
 
   void StartRx (Ptr<SpectrumSignalParameters> params);
 
@@ -248,11 +249,33 @@ public:
   void UpdateSinrPerceived (const SpectrumValue& sinr);
 
   /**
-  * Configure the beamforming to communicate with a specific device
+  * Configure the beamforming to communicate with a specific device. The
+  * beam is not computed again if it already points to the same device and
+  * neither device has moved since it was computed.
   * \param dev the device we want to communicate with
   */
   void ConfigureBeamforming (Ptr<NetDevice> dev);
 
+  /**
+  * \returns the number of calls to ConfigureBeamforming which reused the
+  *          current beam
+  */
+  uint64_t GetBeamformingHits () const;
+
+  /**
+  * \returns the number of calls to ConfigureBeamforming which computed the
+  *          beam
+  */
+  uint64_t GetBeamformingMisses () const;
+
+  /**
+  * TracedCallback signature for the configuration of the beamforming
+  *
+  * \param [in] dev the device we want to communicate with
+  * \param [in] hit true if the current beam was reused
+  */
+  typedef void (* BeamformingTracedCallback)(Ptr<NetDevice> dev, bool hit);
+
 private:
   /**
   * \brief Change state function
@@ -271,7 +294,7 @@ private:
   Ptr<NetDevice> m_device; ///< the device
   Ptr<SpectrumChannel> m_channel; ///< the channel
   Ptr<const SpectrumModel> m_rxSpectrumModel; ///< the spectrum model
-  Ptr<SpectrumValue> m_txPsd; ///< the transmit PSD
+  Ptr<const SpectrumValue> m_txPsd; ///< the transmit PSD, which may be shared among transmissions
   //Ptr<PacketBurst> m_txPacketBurst;
 
   std::list<TbInfo_t> m_rxTransportBlock; ///< the received with associated structure
@@ -301,6 +324,14 @@ private:
 
   EventId m_endTxEvent; ///< end transmit event
   EventId m_endRxDataEvent; ///< end receive data event
+
+  Ptr<NetDevice> m_beamformingDevice; ///< the device the current beam points to
+  Vector m_beamformingPosition; ///< the position of this device when the beam was computed
+  Vector m_beamformingOtherPosition; ///< the position of the other device when the beam was computed
+  uint64_t m_beamformingGeneration; ///< the beamforming generation of the antenna after the beam was computed
+  uint64_t m_beamformingHits; ///< number of beams reused
+  uint64_t m_beamformingMisses; ///< number of beams computed
+  TracedCallback<Ptr<NetDevice>, bool> m_beamformingTrace; ///< trace fired when the beamforming is configured
   //EventId m_endRxCtrlEvent;
 
 };
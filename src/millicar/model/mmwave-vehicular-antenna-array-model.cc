@@ -30,6 +30,7 @@
 #include "ns3/double.h"
 #include "ns3/boolean.h"
 #include "ns3/uinteger.h"
+#include <cmath>
 
 
 NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularAntennaArrayModel");
@@ -40,14 +41,22 @@ namespace millicar {
 
 NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularAntennaArrayModel);
 
+static const double g_patternStep = 0.5;                     // step of the radiation pattern table, in degrees
+static const uint32_t g_patternThetaSize = 180 / g_patternStep + 1;     // samples of the vertical angle, in [0,180]
+static const uint32_t g_patternPhiSize = 360 / g_patternStep + 1;       // samples of the horizontal angle, in [-180,180]
+
 MmWaveVehicularAntennaArrayModel::MmWaveVehicularAntennaArrayModel () :
 m_omniTx {false},
+m_beamformingGeneration {0},
 m_currentPanelId {0},
 m_noPlane {0},
 m_isUe {false},
 m_totNoArrayElements {0},
 m_hpbw {0},       //HPBW value of each antenna element
-m_gMax {0}       //directivity value expressed in dBi and valid only for TRP (see table A.1.6-3 in 38.802)
+m_gMax {0},       //directivity value expressed in dBi and valid only for TRP (see table A.1.6-3 in 38.802)
+m_antennaElementPattern {PATTERN_3GPP_MMWAVE},
+m_patternTable {0},
+m_codebook {0}
 // :m_minAngle (0),m_maxAngle(2*M_PI)
 {
   m_lastUpdateMap.clear ();
@@ -68,12 +77,14 @@ MmWaveVehicularAntennaArrayModel::GetTypeId ()
     .AddAttribute ("AntennaHorizontalSpacing",
                    "Horizontal spacing between antenna elements, in multiples of lambda",
                    DoubleValue (0.5),
-                   MakeDoubleAccessor (&MmWaveVehicularAntennaArrayModel::m_disH),
+                   MakeDoubleAccessor (&MmWaveVehicularAntennaArrayModel::SetAntennaHorizontalSpacing,
+                                      &MmWaveVehicularAntennaArrayModel::GetAntennaHorizontalSpacing),
                    MakeDoubleChecker<double> ())
     .AddAttribute ("AntennaVerticalSpacing",
                    "Vertical spacing between antenna elements, in multiples of lambda",
                    DoubleValue (0.5),
-                   MakeDoubleAccessor (&MmWaveVehicularAntennaArrayModel::m_disV),
+                   MakeDoubleAccessor (&MmWaveVehicularAntennaArrayModel::SetAntennaVerticalSpacing,
+                                      &MmWaveVehicularAntennaArrayModel::GetAntennaVerticalSpacing),
                    MakeDoubleChecker<double> ())
     .AddAttribute ("IsotropicAntennaElements",
                    "If true, the antenna elements are isotropic. If false, they follow the 3GPP spec on element radiation pattern",
@@ -83,7 +94,8 @@ MmWaveVehicularAntennaArrayModel::GetTypeId ()
     .AddAttribute ("AntennaElementPattern",
                    "The available antenna element patterns refer to '3GPP-MmWave', '3GPP-V2V'",
                    StringValue ("3GPP-MmWave"),
-                   MakeStringAccessor (&MmWaveVehicularAntennaArrayModel ::m_antennaElementPattern),
+                   MakeStringAccessor (&MmWaveVehicularAntennaArrayModel::SetAntennaElementPattern,
+                                       &MmWaveVehicularAntennaArrayModel::GetAntennaElementPattern),
                    MakeStringChecker ())
     .AddAttribute ("AntennaElements",
                    "The number of antenna elements",
@@ -96,6 +108,14 @@ MmWaveVehicularAntennaArrayModel::GetTypeId ()
                    UintegerValue (2),
                    MakeUintegerAccessor (&MmWaveVehicularAntennaArrayModel::SetPlanesNumber),
                    MakeUintegerChecker<uint8_t> ())
+    .AddAttribute ("CodebookOversampling",
+                   "Oversampling factor of the DFT codebook used to steer the beams towards the other devices, "
+                   "i.e., number of beams per dimension divided by the number of antenna elements per dimension. "
+                   "If 0, the beams are steered exactly towards the other devices",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&MmWaveVehicularAntennaArrayModel::SetCodebookOversampling,
+                                         &MmWaveVehicularAntennaArrayModel::GetCodebookOversampling),
+                   MakeUintegerChecker<uint32_t> ())
   ;
   return tid;
 }
@@ -128,6 +148,7 @@ void
 MmWaveVehicularAntennaArrayModel::SetTotNoArrayElements (uint64_t arrayElements)
 {
   m_totNoArrayElements = arrayElements;
+  m_codebook = 0;
 }
 
 uint64_t
@@ -136,11 +157,51 @@ MmWaveVehicularAntennaArrayModel::GetTotNoArrayElements () const
   return m_totNoArrayElements;
 }
 
+void
+MmWaveVehicularAntennaArrayModel::SetAntennaHorizontalSpacing (double spacing)
+{
+  m_disH = spacing;
+  m_codebook = 0;
+}
+
+double
+MmWaveVehicularAntennaArrayModel::GetAntennaHorizontalSpacing () const
+{
+  return m_disH;
+}
+
+void
+MmWaveVehicularAntennaArrayModel::SetAntennaVerticalSpacing (double spacing)
+{
+  m_disV = spacing;
+  m_codebook = 0;
+}
+
+double
+MmWaveVehicularAntennaArrayModel::GetAntennaVerticalSpacing () const
+{
+  return m_disV;
+}
+
+void
+MmWaveVehicularAntennaArrayModel::SetCodebookOversampling (uint32_t oversampling)
+{
+  m_codebookOversampling = oversampling;
+  m_codebook = 0;
+}
+
+uint32_t
+MmWaveVehicularAntennaArrayModel::GetCodebookOversampling () const
+{
+  return m_codebookOversampling;
+}
+
 void
 MmWaveVehicularAntennaArrayModel::SetDeviceType (bool isUe)
 {
   m_isUe = isUe;
-  if (m_antennaElementPattern == "3GPP-MmWave")
+  m_patternTable = 0;
+  if (m_antennaElementPattern == PATTERN_3GPP_MMWAVE)
   {
     if (isUe)
     {
@@ -153,15 +214,35 @@ MmWaveVehicularAntennaArrayModel::SetDeviceType (bool isUe)
       m_gMax = 8;           //directivity value expressed in dBi and valid only for TRP (see table A.1.6-3 in 38.802
     }
   }
-  else if (m_antennaElementPattern == "3GPP-V2V")
+  else
   {
       m_hpbw = 90;           //HPBW value of each antenna element
       m_gMax = 5;           //directivity value expressed in dBi and valid only in the case of V2V communication (see table 6.1.4-4 in TR 37.885)
   }
+}
+
+void
+MmWaveVehicularAntennaArrayModel::SetAntennaElementPattern (std::string pattern)
+{
+  if (pattern == "3GPP-MmWave")
+    {
+      m_antennaElementPattern = PATTERN_3GPP_MMWAVE;
+    }
+  else if (pattern == "3GPP-V2V")
+    {
+      m_antennaElementPattern = PATTERN_3GPP_V2V;
+    }
   else
-  {
-    NS_FATAL_ERROR("Unknown antenna element pattern");
-  }
+    {
+      NS_FATAL_ERROR ("Unknown antenna element pattern " << pattern);
+    }
+  m_patternTable = 0;
+}
+
+std::string
+MmWaveVehicularAntennaArrayModel::GetAntennaElementPattern () const
+{
+  return m_antennaElementPattern == PATTERN_3GPP_MMWAVE ? "3GPP-MmWave" : "3GPP-V2V";
 }
 
 double
@@ -209,36 +290,54 @@ MmWaveVehicularAntennaArrayModel::SetBeamformingVectorPanelDevices (Ptr<NetDevic
 
       double hAngleRadian = fmod ((phiAngle + (M_PI / m_noPlane)),2 * M_PI / m_noPlane) - (M_PI / m_noPlane);
       double vAngleRadian = completeAngle.theta;
-      double power = 1 / sqrt (m_totNoArrayElements);
-      uint16_t antennaNum [2];
-      antennaNum[0] = sqrt (m_totNoArrayElements);
-      antennaNum[1] = sqrt (m_totNoArrayElements);
       NS_LOG_INFO ("hAngleRadian: " << hAngleRadian);
 
-      for (uint64_t ind = 0; ind < m_totNoArrayElements; ind++)
-        {
-          Vector loc = GetAntennaLocation (ind, antennaNum);
-          double phase = -2 * M_PI * (sin (vAngleRadian) * cos (hAngleRadian) * loc.x
-                                      + sin (vAngleRadian) * sin (hAngleRadian) * loc.y
-                                      + cos (vAngleRadian) * loc.z);
-          antennaWeights.push_back (exp (std::complex<double> (0, phase)) * power);
-        }
-
       std::map< Ptr<NetDevice>, std::pair<complexVector_t,int> >::iterator iter = m_beamformingVectorPanelMap.find (otherDevice);
       if (iter != m_beamformingVectorPanelMap.end ())
         {
-          (*iter).second = std::make_pair (antennaWeights, panelId);
           m_lastUpdatePairMap[otherDevice] = Simulator::Now ();
         }
       else
         {
-          m_beamformingVectorPanelMap.insert (std::make_pair (otherDevice, std::make_pair (antennaWeights, panelId) ));
+          iter = m_beamformingVectorPanelMap.insert (std::make_pair (otherDevice, std::make_pair (complexVector_t (), 0))).first;
           m_lastUpdatePairMap.insert (std::make_pair (otherDevice, Simulator::Now ()));
 
           NS_LOG_INFO ("m_lastUpdatePairMap.size " << m_lastUpdatePairMap.size ());
         }
+      iter->second.second = panelId;
+
+      // the stored vectors are overwritten, which does not allocate once they
+      // have the right size
+      if (m_codebookOversampling > 0)
+        {
+          const complexVector_t &beam = GetCodebookBeam (vAngleRadian, hAngleRadian);
+          iter->second.first = beam;
+          m_beamformingVector = beam;
+        }
+      else
+        {
+          double power = 1 / sqrt (m_totNoArrayElements);
+          uint16_t antennaNum [2];
+          antennaNum[0] = sqrt (m_totNoArrayElements);
+          antennaNum[1] = sqrt (m_totNoArrayElements);
+
+          for (uint64_t ind = 0; ind < m_totNoArrayElements; ind++)
+            {
+              Vector loc = GetAntennaLocation (ind, antennaNum);
+              double phase = -2 * M_PI * (sin (vAngleRadian) * cos (hAngleRadian) * loc.x
+                                          + sin (vAngleRadian) * sin (hAngleRadian) * loc.y
+                                          + cos (vAngleRadian) * loc.z);
+              antennaWeights.push_back (exp (std::complex<double> (0, phase)) * power);
+            }
+          iter->second.first = antennaWeights;
+          m_beamformingVector = antennaWeights;
+        }
+    }
+  else
+    {
+      m_beamformingVector = antennaWeights;
     }
-  m_beamformingVector = antennaWeights;
+  m_beamformingGeneration++;
   m_currentPanelId = panelId;
   m_currentDev = otherDevice;
   NS_LOG_INFO ("panelId: " << panelId);
@@ -281,6 +380,7 @@ MmWaveVehicularAntennaArrayModel::ChangeBeamformingVectorPanel (Ptr<NetDevice> d
   NS_ASSERT_MSG (it != m_beamformingVectorPanelMap.end (), "could not find");
   NS_LOG_DEBUG ("ChangeBeamformingVectorPanel towards dev " << device << " prev panel " << m_currentPanelId << " updated to " << it->second.second);
   m_beamformingVector = it->second.first;
+  m_beamformingGeneration++;
   m_currentPanelId = it->second.second;
   m_currentDev = device;
 }
@@ -296,6 +396,12 @@ MmWaveVehicularAntennaArrayModel::GetBeamformingVectorPanel ()
   return m_beamformingVector;
 }
 
+uint64_t
+MmWaveVehicularAntennaArrayModel::GetBeamformingGeneration () const
+{
+  return m_beamformingGeneration;
+}
+
 void
 MmWaveVehicularAntennaArrayModel::ChangeToOmniTx ()
 {
@@ -339,15 +445,58 @@ MmWaveVehicularAntennaArrayModel::GetRadiationPattern (double vAngleRadian, doub
       return 1;
     }
 
-  while (hAngleRadian >= M_PI)
+  if (m_patternTable == 0)
     {
-      hAngleRadian -= 2 * M_PI;
+      // the table depends only on the pattern, the HPBW and the max gain,
+      // therefore it is computed once and shared by all the antennas
+      static std::map<std::pair<int, std::pair<double, double> >, std::vector<double> > tables;
+      std::vector<double> &table = tables[std::make_pair (m_antennaElementPattern, std::make_pair (m_hpbw, m_gMax))];
+      if (table.empty ())
+        {
+          NS_LOG_DEBUG ("Compute the radiation pattern table for pattern " << GetAntennaElementPattern ()
+                        << " hpbw " << m_hpbw << " gMax " << m_gMax);
+          table.resize (g_patternThetaSize * g_patternPhiSize);
+          for (uint32_t t = 0; t < g_patternThetaSize; t++)
+            {
+              for (uint32_t p = 0; p < g_patternPhiSize; p++)
+                {
+                  table[t * g_patternPhiSize + p] = GetRadiationPatternAnalytic (t * g_patternStep * M_PI / 180,
+                                                                                 (p * g_patternStep - 180) * M_PI / 180);
+                }
+            }
+        }
+      m_patternTable = &table;
     }
-  while (hAngleRadian < -M_PI)
+
+  hAngleRadian -= 2 * M_PI * std::floor ((hAngleRadian + M_PI) / (2 * M_PI));
+
+  double vAngle = vAngleRadian * 180 / M_PI;
+  double hAngle = hAngleRadian * 180 / M_PI;
+  NS_ASSERT_MSG (vAngle >= 0&&vAngle <= 180, "the vertical angle should be the range of [0,180]");
+
+  // bilinear interpolation of the table
+  double t = std::min (std::max (vAngle / g_patternStep, 0.0), g_patternThetaSize - 1.0);
+  double p = std::min (std::max ((hAngle + 180) / g_patternStep, 0.0), g_patternPhiSize - 1.0);
+  uint32_t t0 = std::min (static_cast<uint32_t> (t), g_patternThetaSize - 2);
+  uint32_t p0 = std::min (static_cast<uint32_t> (p), g_patternPhiSize - 2);
+  double ft = t - t0;
+  double fp = p - p0;
+
+  const double *row = &(*m_patternTable)[t0 * g_patternPhiSize + p0];
+  return (1 - ft) * ((1 - fp) * row[0] + fp * row[1])
+         + ft * ((1 - fp) * row[g_patternPhiSize] + fp * row[g_patternPhiSize + 1]);
+}
+
+double
+MmWaveVehicularAntennaArrayModel::GetRadiationPatternAnalytic (double vAngleRadian, double hAngleRadian) const
+{
+  if (m_isotropicElement)
     {
-      hAngleRadian += 2 * M_PI;
+      return 1;
     }
 
+  hAngleRadian -= 2 * M_PI * std::floor ((hAngleRadian + M_PI) / (2 * M_PI));
+
   double vAngle = vAngleRadian * 180 / M_PI;
   double hAngle = hAngleRadian * 180 / M_PI;
   //NS_LOG_INFO(" it is " << vAngle);
@@ -358,20 +507,16 @@ MmWaveVehicularAntennaArrayModel::GetRadiationPattern (double vAngleRadian, doub
   double A_M = 0;       //front-back ratio expressed in dB
   double SLA = 0;       //side-lobe level limit expressed in dB
 
-  if (m_antennaElementPattern == "3GPP-MmWave") //front-back ratio and side-lobe level in case of standard mmWave antenna configuration
+  if (m_antennaElementPattern == PATTERN_3GPP_MMWAVE) //front-back ratio and side-lobe level in case of standard mmWave antenna configuration
   {
     A_M = 30;
     SLA = 30;
   }
-  else if (m_antennaElementPattern == "3GPP-V2V") //front-back ratio and side-lobe level values in case of V2V antenna configuration
+  else //front-back ratio and side-lobe level values in case of V2V antenna configuration
   {
     A_M = 25;
     SLA = 25;
   }
-  else
-  {
-    NS_FATAL_ERROR("Unknown antenna element pattern");
-  }
 
   double A_v = -1 * std::min (SLA,12 * pow ((vAngle - 90) / m_hpbw,2));      //TODO: check position of z-axis zero
   double A_h = -1 * std::min (A_M,12 * pow (hAngle / m_hpbw,2));
@@ -380,6 +525,57 @@ MmWaveVehicularAntennaArrayModel::GetRadiationPattern (double vAngleRadian, doub
   return sqrt (pow (10,A / 10));     //filed factor term converted to linear;
 }
 
+const complexVector_t&
+MmWaveVehicularAntennaArrayModel::GetCodebookBeam (double vAngleRadian, double hAngleRadian)
+{
+  // The phase of each element depends only on the direction cosines
+  // u = sin(theta) sin(phi) and w = cos(theta), since the array lies on the
+  // y-z plane. The codebook samples u and w uniformly in [-1, 1], with
+  // oversampling times the number of elements per row and column.
+  uint16_t antennaNum [2];
+  antennaNum[0] = sqrt (m_totNoArrayElements);
+  antennaNum[1] = sqrt (m_totNoArrayElements);
+  uint32_t numBeamsH = m_codebookOversampling * antennaNum[0];
+  uint32_t numBeamsV = m_codebookOversampling * antennaNum[1];
+
+  if (m_codebook == 0)
+    {
+      static std::map<std::pair<std::pair<double, double>, std::pair<uint64_t, uint32_t> >, std::vector<complexVector_t> > codebooks;
+      std::vector<complexVector_t> &codebook = codebooks[std::make_pair (std::make_pair (m_disH, m_disV),
+                                                                         std::make_pair (m_totNoArrayElements, m_codebookOversampling))];
+      if (codebook.empty ())
+        {
+          NS_LOG_DEBUG ("Compute the codebook for " << m_totNoArrayElements << " elements, oversampling " << m_codebookOversampling);
+          double power = 1 / sqrt (m_totNoArrayElements);
+          codebook.resize ((numBeamsH + 1) * (numBeamsV + 1));
+          for (uint32_t iw = 0; iw <= numBeamsV; iw++)
+            {
+              double w = 2.0 * iw / numBeamsV - 1;
+              for (uint32_t iu = 0; iu <= numBeamsH; iu++)
+                {
+                  double u = 2.0 * iu / numBeamsH - 1;
+                  complexVector_t &beam = codebook[iw * (numBeamsH + 1) + iu];
+                  beam.reserve (m_totNoArrayElements);
+                  for (uint64_t ind = 0; ind < m_totNoArrayElements; ind++)
+                    {
+                      Vector loc = GetAntennaLocation (ind, antennaNum);
+                      double phase = -2 * M_PI * (u * loc.y + w * loc.z);
+                      beam.push_back (exp (std::complex<double> (0, phase)) * power);
+                    }
+                }
+            }
+        }
+      m_codebook = &codebook;
+    }
+
+  double u = sin (vAngleRadian) * sin (hAngleRadian);
+  double w = cos (vAngleRadian);
+  uint32_t iu = std::min<uint32_t> (std::floor ((u + 1) * numBeamsH / 2 + 0.5), numBeamsH);
+  uint32_t iw = std::min<uint32_t> (std::floor ((w + 1) * numBeamsV / 2 + 0.5), numBeamsV);
+  NS_LOG_DEBUG ("Codebook beam " << iu << " " << iw);
+  return (*m_codebook)[iw * (numBeamsH + 1) + iu];
+}
+
 Vector
 MmWaveVehicularAntennaArrayModel::GetAntennaLocation (uint16_t index, uint16_t* antennaNum)
 {
@@ -408,6 +604,7 @@ MmWaveVehicularAntennaArrayModel::SetSector (uint8_t sector, uint16_t *antennaNu
       tempVector.push_back (exp (std::complex<double> (0, phase)) * power);
     }
   m_beamformingVector = tempVector;
+  m_beamformingGeneration++;
 }
 
 Time
@@ -39,6 +39,12 @@ typedef std::vector< std::complex<double> > complexVector_t;
 class MmWaveVehicularAntennaArrayModel : public AntennaModel
 {
 public:
+  enum ElementPattern
+  {
+    PATTERN_3GPP_MMWAVE,       // 3GPP TR 38.901
+    PATTERN_3GPP_V2V           // 3GPP TR 37.885
+  };
+
   MmWaveVehicularAntennaArrayModel ();
   virtual ~MmWaveVehicularAntennaArrayModel ();
   static TypeId GetTypeId ();
@@ -52,28 +58,41 @@ public:
   void ChangeBeamformingVectorPanel (Ptr<NetDevice> device);
   complexVector_t GetBeamformingVectorPanel ();
   complexVector_t GetBeamformingVectorPanel (Ptr<NetDevice> device);
+  uint64_t GetBeamformingGeneration () const;
 
   void ChangeToOmniTx ();
   bool IsOmniTx ();
   double GetRadiationPattern (double vangle, double hangle = 0);
+  double GetRadiationPatternAnalytic (double vangle, double hangle = 0) const;
   Vector GetAntennaLocation (uint16_t index, uint16_t* antennaNum);
   void SetSector (uint8_t sector, uint16_t *antennaNum, double elevation = 90);
 
   void SetPlanesNumber (uint8_t planesNumber);
   double GetPlanesId (void);
   void SetDeviceType (bool isUe);
+  void SetAntennaElementPattern (std::string pattern);
+  std::string GetAntennaElementPattern () const;
   void SetTotNoArrayElements (uint64_t arrayElements);
   uint64_t GetTotNoArrayElements () const;
+  void SetAntennaHorizontalSpacing (double spacing);
+  double GetAntennaHorizontalSpacing () const;
+  void SetAntennaVerticalSpacing (double spacing);
+  double GetAntennaVerticalSpacing () const;
+  void SetCodebookOversampling (uint32_t oversampling);
+  uint32_t GetCodebookOversampling () const;
   double GetOffset ();
 
   Ptr<NetDevice> GetCurrentDevice ();
   Time GetLastUpdate (Ptr<NetDevice> device);
 
 private:
+  const complexVector_t& GetCodebookBeam (double vAngleRadian, double hAngleRadian);
+
   bool m_omniTx;
   // double m_minAngle;
   // double m_maxAngle;
   complexVector_t m_beamformingVector;
+  uint64_t m_beamformingGeneration; // incremented when m_beamformingVector is changed
   int m_currentPanelId;
   // std::map<Ptr<NetDevice>, complexVector_t> m_beamformingVectorMap;
   std::map<Ptr<NetDevice>, std::pair<complexVector_t,int> > m_beamformingVectorPanelMap;
@@ -94,7 +113,11 @@ private:
 
   bool m_isotropicElement;
 
-  std::string m_antennaElementPattern; // configuration of antenna parameters based on different 3GPP technical reports (38.901, 37.885)
+  ElementPattern m_antennaElementPattern; // configuration of antenna parameters based on different 3GPP technical reports (38.901, 37.885)
+  const std::vector<double> *m_patternTable; // field pattern sampled over (theta, phi), shared by the antennas with the same configuration
+
+  uint32_t m_codebookOversampling; // oversampling factor of the DFT codebook, 0 to steer the beams exactly
+  const std::vector<complexVector_t> *m_codebook; // DFT codebook, shared by the antennas with the same configuration
 };
 
 } /* namespace millicar */
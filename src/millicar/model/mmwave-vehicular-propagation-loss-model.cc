@@ -24,14 +24,19 @@
 
 #include "mmwave-vehicular-propagation-loss-model.h"
 #include <ns3/log.h>
+#include <ns3/abort.h>
 #include "ns3/mobility-model.h"
 #include "ns3/boolean.h"
 #include "ns3/double.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/nstime.h"
+#include "ns3/trace-source-accessor.h"
 #include <ns3/simulator.h>
 #include <ns3/node.h>
 #include <random>
+#include <cmath>
+#include <limits>
 
 namespace ns3 {
 
@@ -44,6 +49,18 @@ NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularPropagationLossModel);
 
 static const double g_C = 299792458.0;   // speed of light in vacuum
 
+/**
+ * \param mob the mobility model of a device
+ * \returns the id of the node the mobility model is aggregated to
+ */
+static uint32_t
+GetNodeId (Ptr<MobilityModel> mob)
+{
+  Ptr<Node> node = mob->GetObject<Node> ();
+  NS_ABORT_MSG_IF (node == 0, "The links are identified by node ids, the mobility model must be aggregated to a node");
+  return node->GetId ();
+}
+
 
 
 
@@ -68,18 +85,26 @@ MmWaveVehicularPropagationLossModel::GetTypeId (void)
     .AddAttribute ("ChannelCondition",
                    "'l' for LOS, 'n' for NLOS, 'v' for NLOSv, 'a' for all",
                    StringValue ("a"),
-                   MakeStringAccessor (&MmWaveVehicularPropagationLossModel::m_channelConditions),
+                   MakeStringAccessor (&MmWaveVehicularPropagationLossModel::SetChannelConditionMode,
+                                       &MmWaveVehicularPropagationLossModel::GetChannelConditionMode),
                    MakeStringChecker ())
     .AddAttribute ("Scenario",
                    "The available channel scenarios are 'V2V-Highway', 'V2V-Urban', 'Extended-V2V-Highway','Extended-V2V-Urban'",
                    StringValue ("V2V-Highway"),
-                   MakeStringAccessor (&MmWaveVehicularPropagationLossModel::m_scenario),
+                   MakeStringAccessor (&MmWaveVehicularPropagationLossModel::SetScenario,
+                                       &MmWaveVehicularPropagationLossModel::GetScenario),
                    MakeStringChecker ())
     .AddAttribute ("Shadowing",
                    "Enable shadowing effect",
                    BooleanValue (true),
                    MakeBooleanAccessor (&MmWaveVehicularPropagationLossModel::m_shadowingEnabled),
                    MakeBooleanChecker ())
+    .AddAttribute ("ShadowingField",
+                   "If true, the shadowing is sampled from a spatially consistent field shared by all the links, "
+                   "with the decorrelation distance of the scenario, instead of a per-link correlated process",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MmWaveVehicularPropagationLossModel::m_shadowingFieldEnabled),
+                   MakeBooleanChecker ())
     .AddAttribute ("SnowEffect",
                    "Enable snow attenuation",
                    BooleanValue (true),
@@ -90,13 +115,28 @@ MmWaveVehicularPropagationLossModel::GetTypeId (void)
                    DoubleValue (0.0),
                    MakeDoubleAccessor (&MmWaveVehicularPropagationLossModel::m_percType3Vehicles),
                    MakeDoubleChecker<double> ())
+    .AddAttribute ("LinkStateTimeout",
+                   "The channel condition and the shadowing of a link are discarded if the link "
+                   "has not been used for this time, e.g., because a vehicle left the simulation. "
+                   "Zero keeps the links forever. A link which is used again after expiring gets a "
+                   "new channel condition and shadowing, which changes the results.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&MmWaveVehicularPropagationLossModel::m_linkStateTimeout),
+                   MakeTimeChecker ())
+    .AddTraceSource ("NlosvBlockage",
+                     "The vehicle blockage drawn for a link in NLOSv condition.",
+                     MakeTraceSourceAccessor (&MmWaveVehicularPropagationLossModel::m_nlosvBlockageTrace),
+                     "ns3::millicar::MmWaveVehicularPropagationLossModel::NlosvBlockageTracedCallback")
   ;
   return tid;
 }
 
 MmWaveVehicularPropagationLossModel::MmWaveVehicularPropagationLossModel ()
+  : m_frequency (0.0),
+    m_fixedCondition (0),
+    m_scenarioId (V2V_HIGHWAY)
 {
-  m_channelConditionMap.clear ();
+  m_linkStates.Clear ();
   m_norVar = CreateObject<NormalRandomVariable> ();
   m_norVar->SetAttribute ("Mean", DoubleValue (0));
   m_norVar->SetAttribute ("Variance", DoubleValue (1));
@@ -108,6 +148,7 @@ MmWaveVehicularPropagationLossModel::MmWaveVehicularPropagationLossModel ()
   m_uniformVar->SetAttribute ("Min", DoubleValue (0));
   m_uniformVar->SetAttribute ("Max", DoubleValue (1));
 
+  m_weatherAttenuation = CreateObject<WeatherAttenuation> ();
 }
 
 void
@@ -126,6 +167,138 @@ MmWaveVehicularPropagationLossModel::SetFrequency (double freq)
 {
   m_frequency = freq;
   m_lambda = g_C / m_frequency;
+  m_weatherAttenuation->SetFrequency (freq);
+  UpdateConditionParams ();
+}
+
+void
+MmWaveVehicularPropagationLossModel::SetScenario (std::string scenario)
+{
+  if (scenario == "V2V-Highway")
+    {
+      m_scenarioId = V2V_HIGHWAY;
+    }
+  else if (scenario == "V2V-Urban")
+    {
+      m_scenarioId = V2V_URBAN;
+    }
+  else if (scenario == "Extended-V2V-Highway")
+    {
+      m_scenarioId = EXTENDED_V2V_HIGHWAY;
+    }
+  else if (scenario == "Extended-V2V-Urban")
+    {
+      m_scenarioId = EXTENDED_V2V_URBAN;
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown channel scenario " << scenario);
+    }
+  m_scenario = scenario;
+  UpdateConditionParams ();
+}
+
+std::string
+MmWaveVehicularPropagationLossModel::GetScenario (void) const
+{
+  return m_scenario;
+}
+
+void
+MmWaveVehicularPropagationLossModel::SetChannelConditionMode (std::string condition)
+{
+  if (condition == "l" || condition == "n" || condition == "v")
+    {
+      m_fixedCondition = condition[0];
+    }
+  else if (condition == "a")
+    {
+      m_fixedCondition = 0;
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Wrong channel condition configuration");
+    }
+  m_channelConditions = condition;
+}
+
+std::string
+MmWaveVehicularPropagationLossModel::GetChannelConditionMode (void) const
+{
+  return m_channelConditions;
+}
+
+void
+MmWaveVehicularPropagationLossModel::UpdateConditionParams (void)
+{
+  // the frequency term of the path loss is evaluated only once
+  double logFreqGHz = m_frequency > 0 ? log10 (m_frequency / 1e9) : 0.0;
+
+  bool highway = (m_scenarioId == V2V_HIGHWAY || m_scenarioId == EXTENDED_V2V_HIGHWAY);
+  if (highway)
+    {
+      m_losParams.m_intercept = 32.4 + 20 * logFreqGHz;
+      m_losParams.m_distanceCoeff = 20;
+    }
+  else
+    {
+      m_losParams.m_intercept = 38.77 + 18.2 * logFreqGHz;
+      m_losParams.m_distanceCoeff = 16.7;
+    }
+  // NLOSv has the same path loss as LOS, plus the blockage loss
+  m_nlosvParams = m_losParams;
+  m_nlosParams.m_intercept = 36.85 + 18.9 * logFreqGHz;
+  m_nlosParams.m_distanceCoeff = 30;
+
+  // The shadowing standard deviation and decorrelation distance are
+  // specified in TR 36.885 Sec. A.1.4. The extended model does not specify
+  // the decorrelation distance, the one of TR 36.885 is assumed.
+  double corDistance = highway ? 25.0 : 10.0;
+  m_losParams.m_shadowingStd = 3.0;
+  m_losParams.m_shadowingCorDistance = corDistance;
+  m_nlosParams.m_shadowingStd = 4.0;
+  m_nlosParams.m_shadowingCorDistance = corDistance;
+  m_nlosvParams.m_shadowingStd = 0.0;
+  m_nlosvParams.m_shadowingCorDistance = 0.0;
+
+  // the shadowing field depends on the decorrelation distance
+  m_shadowingField = nullptr;
+
+  if (m_scenarioId == V2V_HIGHWAY)
+    {
+      // TR 36.885 uses the same shadowing for all the conditions
+      m_nlosParams.m_shadowingStd = 3.0;
+      m_nlosvParams.m_shadowingStd = 3.0;
+      m_nlosvParams.m_shadowingCorDistance = corDistance;
+    }
+}
+
+Ptr<ShadowingField>
+MmWaveVehicularPropagationLossModel::GetShadowingField (void) const
+{
+  if (!m_shadowingField)
+    {
+      uint32_t seed = m_uniformVar->GetInteger (0, std::numeric_limits<uint32_t>::max () - 1);
+      m_shadowingField = Create<ShadowingField> (m_losParams.m_shadowingCorDistance, seed);
+    }
+  return m_shadowingField;
+}
+
+const MmWaveVehicularPropagationLossModel::ConditionParams &
+MmWaveVehicularPropagationLossModel::GetConditionParams (char condition) const
+{
+  switch (condition)
+    {
+    case 'l':
+      return m_losParams;
+    case 'n':
+      return m_nlosParams;
+    case 'v':
+      return m_nlosvParams;
+    default:
+      NS_FATAL_ERROR ("Programming Error.");
+    }
+  return m_losParams;
 }
 
 double
@@ -148,17 +321,15 @@ MmWaveVehicularPropagationLossModel::GetWeatherAttenuation (double distance3D, d
 {
   double weatherAtten = 0;
 
-  if(m_snowEnabled)
-  {
-   Ptr<RainSnowAttenuation>snowAtten = CreateObject<RainSnowAttenuation>();
-   weatherAtten = snowAtten->getSnowAttenuation(distance3D, m_frequency, hA, hB);
-  }
+  if (m_snowEnabled)
+    {
+      weatherAtten = m_weatherAttenuation->GetSnowAttenuation (distance3D, hA, hB);
+    }
   else
-  {
-    Ptr<RainAttenuation>rainAtten = CreateObject<RainAttenuation>();
-    weatherAtten = rainAtten->getRainAttenuation(distance3D, m_frequency);
-  }
-  
+    {
+      weatherAtten = m_weatherAttenuation->GetRainAttenuation (distance3D);
+    }
+
   return weatherAtten;
 }
 
@@ -166,355 +337,283 @@ double
 MmWaveVehicularPropagationLossModel::GetLoss (Ptr<MobilityModel> deviceA, Ptr<MobilityModel> deviceB) const
 {
   NS_ASSERT_MSG (m_frequency != 0.0, "Set the operating frequency first!");
-  
+
+  SweepLinkStates ();
+
   Vector aPos = deviceA->GetPosition ();
   Vector bPos = deviceB->GetPosition ();
 
-  double x = aPos.x - bPos.x;
-  double y = aPos.y - bPos.y;
-  double distance2D = sqrt (x * x + y * y);
-  double hA = aPos.z;
-  double hB = bPos.z;
-
- 
+  double distance3D = CalculateDistance (aPos, bPos);
+  double weatherAtten = m_shadowingEnabled && distance3D > 0 ? GetWeatherAttenuation (distance3D, aPos.z, bPos.z) : 0;
+  return CalcLinkLoss (GetNodeId (deviceA), GetNodeId (deviceB), aPos, bPos, distance3D, log10 (distance3D), weatherAtten);
+}
 
-  double distance3D = deviceA->GetDistanceFrom (deviceB);
-  
+void
+MmWaveVehicularPropagationLossModel::GetLoss (Ptr<MobilityModel> tx, const std::vector<Ptr<MobilityModel> > &rx, double *lossDb) const
+{
+  NS_ASSERT_MSG (m_frequency != 0.0, "Set the operating frequency first!");
 
-  if (distance3D < 3 * m_lambda)
+  SweepLinkStates ();
+
+  Vector txPos = tx->GetPosition ();
+  uint32_t txId = GetNodeId (tx);
+  size_t n = rx.size ();
+
+  // gather the receiver positions in contiguous buffers, then compute the
+  // deterministic terms of all the links in loops over the buffers
+  m_batchX.resize (n);
+  m_batchY.resize (n);
+  m_batchZ.resize (n);
+  m_batchDistance.resize (n);
+  m_batchLogDistance.resize (n);
+  m_batchWeather.resize (n);
+  for (size_t i = 0; i < n; ++i)
     {
-      NS_LOG_UNCOND ("distance not within the far field region => inaccurate propagation loss value");
+      Vector pos = rx[i]->GetPosition ();
+      m_batchX[i] = pos.x;
+      m_batchY[i] = pos.y;
+      m_batchZ[i] = pos.z;
     }
-  if (distance3D <= 0)
+  for (size_t i = 0; i < n; ++i)
     {
-      return m_minLoss;
+      double dx = m_batchX[i] - txPos.x;
+      double dy = m_batchY[i] - txPos.y;
+      double dz = m_batchZ[i] - txPos.z;
+      m_batchDistance[i] = std::sqrt (dx * dx + dy * dy + dz * dz);
     }
-
-  channelConditionMap_t::const_iterator it;
-  it = m_channelConditionMap.find (std::make_pair (deviceA, deviceB));
-  if (it == m_channelConditionMap.end ())
+  for (size_t i = 0; i < n; ++i)
     {
-      channelCondition condition;
-
-      if (m_channelConditions.compare ("l") == 0 )
-        {
-          condition.m_channelCondition = 'l';
-          NS_LOG_UNCOND (m_scenario << " scenario, channel condition is fixed to be " << condition.m_channelCondition << ", h_A=" << hA << ",h_B=" << hB);
-        }
-      else if (m_channelConditions.compare ("n") == 0)
-        {
-          condition.m_channelCondition = 'n';
-          NS_LOG_UNCOND (m_scenario << " scenario, channel condition is fixed to be " << condition.m_channelCondition << ", h_A=" << hA << ",h_B=" << hB);
-        }
-      else if (m_channelConditions.compare ("v") == 0)
-        {
-          condition.m_channelCondition = 'v';
-          NS_LOG_UNCOND (m_scenario << " scenario, channel condition is fixed to be " << condition.m_channelCondition << ", h_A=" << hA << ",h_B=" << hB);
-        }
-      else if (m_channelConditions.compare ("a") == 0)
-        {
-          double PRef = m_uniformVar->GetValue ();
-          double probLos, probnLos, probnLosv;
-
-          if (m_scenario == "V2V-Highway")
-            {
-              double a, b, c;
-              a = 2.1013e-6;
-              b = - 0.002;
-              c = 1.0193;
-
-              if (distance3D <= 475)
-              {
-                probLos = std::min(1.0, a * pow(distance3D, 2) + b * distance3D + c);
-              }
-              else
-              {
-                probLos = std::max(0.0, 0.54 - 0.001 * (distance3D - 475));
-              }
-
-              if (PRef <= probLos)
-              {
-                condition.m_channelCondition = 'l';
-              }
-              else
-              {
-                condition.m_channelCondition = 'v';
-              }
-            }
-          else if (m_scenario == "V2V-Urban")
-            {
-              probLos = std::min(1.0, 1.05 * exp(-0.0114 * distance3D));
-
-              if (PRef <= probLos)
-              {
-                condition.m_channelCondition = 'l';
-              }
-              else
-              {
-                condition.m_channelCondition = 'v';
-              }
-            }
-          else if (m_scenario == "Extended-V2V-Highway")
-            {
-              // As established from TR 37.885 we  have to define
-              double aLOS, bLOS, cLOS = 1;
-              aLOS = 2.7e-6;
-              bLOS = - 0.0025;
-
-              probLos = std::min(1.0, std::max(0.0, aLOS * pow(distance3D, 2) + bLOS * distance3D + cLOS));
-
-              double aNLOS, bNLOS, cNLOS = 0.015;
-              aNLOS = -3.7e-7;
-              bNLOS = 0.00061;
-
-              probnLos = std::min(1.0, std::max(0.0, aNLOS * pow(distance3D, 2) + bNLOS * distance3D + cNLOS));
-
-              if (PRef <= probLos)
-                {
-                  condition.m_channelCondition = 'l';
-                }
-              else if (PRef <= probLos + probnLos)
-                {
-                  condition.m_channelCondition = 'n';
-                }
-              else
-                {
-                  condition.m_channelCondition = 'v';
-                }
-            }
-          else if (m_scenario == "Extended-V2V-Urban")
-            {
-              probLos = std::min(1.0, std::max(0.0, 0.8372 * exp (-0.0114*distance3D)));
-              probnLosv = std::min(1.0, std::max(0.0, 1/(0.0312*distance3D) * exp(- pow(log(distance3D) - 5.0063, 2) / 2.4544)));
-
-              if (PRef <= probLos)
-                {
-                  condition.m_channelCondition = 'l';
-                }
-              else if (PRef <= probLos + probnLosv)
-                {
-                  condition.m_channelCondition = 'v';
-                }
-              else
-                {
-                  condition.m_channelCondition = 'n';
-                }
-            }
-          else
-            {
-              NS_FATAL_ERROR ("Unknown scenario");
-            }
-
-          NS_LOG_DEBUG (m_scenario << " scenario, 2D distance = " << distance2D << "m, Prob_LOS = " << probLos
-                                    << ", Prob_REF = " << PRef << ", the channel condition is " << condition.m_channelCondition << ", h_A=" << hA << ",h_B=" << hB);
-        }
-      else
-        {
-          NS_FATAL_ERROR ("Wrong channel condition configuration");
-        }
-
-      // assign a large negative value to identify initial transmission.
-      condition.m_shadowing = -1e6;
-
-      std::pair<channelConditionMap_t::const_iterator, bool> ret;
-      ret = m_channelConditionMap.insert (std::make_pair (std::make_pair (deviceA, deviceB), condition));
-      m_channelConditionMap.insert (std::make_pair (std::make_pair (deviceB, deviceA), condition));
-      it = ret.first;
-        
+      m_batchLogDistance[i] = log10 (m_batchDistance[i]);
     }
-
-  double lossDb = 0;
-  double freqGHz = m_frequency / 1e9;
-
-  double shadowingStd = 0;
-  double shadowingCorDistance = 0;
-  double weatherAtten = 0;
-
-
-  if (m_scenario == "V2V-Highway")
-  {
-    // The shadowing standard deviation and decorrelation distance are
-    // specified in TR 36.885 Sec. A.1.4
-    shadowingStd = 3.0;
-    shadowingCorDistance = 25.0;
-
-    switch ((*it).second.m_channelCondition)
+  for (size_t i = 0; i < n; ++i)
     {
-      case 'l':
-      {
-        lossDb = 32.4 + 20 * log10 (distance3D) + 20 * log10 (freqGHz);
-        break;
-      }
-      case 'v':
-      {
-        double additionalLoss = GetAdditionalNlosVLoss (distance3D, hA, hB);
-        lossDb = 32.4 + 20 * log10 (distance3D) + 20 * log10 (freqGHz) + additionalLoss;
-        break;
-      }
-      case 'n':
-      {
-        lossDb = 36.85 + 30 * log10 (distance3D) + 18.9 * log10 (freqGHz);
-        break;
-      }
-      default:
-        NS_FATAL_ERROR ("Programming Error.");
+      m_batchWeather[i] = m_shadowingEnabled && m_batchDistance[i] > 0 ? GetWeatherAttenuation (m_batchDistance[i], txPos.z, m_batchZ[i]) : 0;
+    }
 
+  // the channel condition, the NLOSv blockage and the shadowing are drawn
+  // link by link, in the same order as N calls to GetLoss (tx, rx[i]): the
+  // condition and the blockage share a random stream, hence drawing them in
+  // separate loops would change the results
+  for (size_t i = 0; i < n; ++i)
+    {
+      Vector rxPos (m_batchX[i], m_batchY[i], m_batchZ[i]);
+      lossDb[i] = CalcLinkLoss (txId, GetNodeId (rx[i]), txPos, rxPos, m_batchDistance[i],
+                                m_batchLogDistance[i], m_batchWeather[i]);
     }
-  }
-  else if (m_scenario == "V2V-Urban")
-  {
-    switch ((*it).second.m_channelCondition)
+}
+
+void
+MmWaveVehicularPropagationLossModel::SweepLinkStates (void) const
+{
+  if (!m_linkStateTimeout.IsZero () && Simulator::Now () - m_lastLinkStateSweep >= m_linkStateTimeout)
     {
-      case 'l':
-      {
-        lossDb = 38.77 + 16.7 * log10 (distance3D) + 18.2 * log10 (freqGHz);
-
-        // The shadowing standard deviation and decorrelation distance are
-        // specified in TR 36.885 Sec. A.1.4
-        shadowingStd = 3.0;
-        shadowingCorDistance = 10.0;
-        break;
-      }
-      case 'v':
-      {
-        double additionalLoss = GetAdditionalNlosVLoss (distance3D, hA, hB);
-        lossDb = 38.77 + 16.7 * log10 (distance3D) + 18.2 * log10 (freqGHz) + additionalLoss;
-        break;
-
-      }
-      case 'n':
-      {
-        lossDb = 36.85 + 30 * log10 (distance3D) + 18.9 * log10 (freqGHz);
-
-        // The shadowing standard deviation and decorrelation distance are
-        // specified in TR 36.885 Sec. A.1.4
-        shadowingStd = 4.0;
-        shadowingCorDistance = 10.0;
-        break;
-      }
-      default:
-        NS_FATAL_ERROR ("Programming Error.");
+      m_linkStates.RemoveIdle (Simulator::Now () - m_linkStateTimeout);
+      m_lastLinkStateSweep = Simulator::Now ();
+    }
+}
+
+double
+MmWaveVehicularPropagationLossModel::CalcLinkLoss (uint32_t idA, uint32_t idB, const Vector &aPos, const Vector &bPos,
+                                                   double distance3D, double logDistance, double weatherAtten) const
+{
+  double hA = aPos.z;
+  double hB = bPos.z;
 
+  if (distance3D < 3 * m_lambda)
+    {
+      NS_LOG_UNCOND ("distance not within the far field region => inaccurate propagation loss value");
     }
-  }
-  else if (m_scenario == "Extended-V2V-Highway")
-  {
-    switch ((*it).second.m_channelCondition)
+  if (distance3D <= 0)
     {
-      case 'l':
-      {
-        lossDb = 32.4 + 20 * log10 (distance3D) + 20 * log10 (freqGHz);
-
-        shadowingStd = 3.0;
-        // The extended model does not specify the decorrelation distance. I
-        // assume the one specified by TR 36.885
-        shadowingCorDistance = 25.0;
-        break;
-      }
-      case 'v':
-      {
-        double additionalLoss = GetAdditionalNlosVLoss (distance3D, hA, hB);
-
-        lossDb = 32.4 + 20 * log10 (distance3D) + 20 * log10 (freqGHz) + additionalLoss;
-        break;
-      }
-      case 'n':
-      {
-        lossDb = 36.85 + 30 * log10 (distance3D) + 18.9 * log10 (freqGHz);
-        shadowingStd = 4.0;
-        // The extended model does not specify the decorrelation distance. I
-        // assume the one specified by TR 36.885
-        shadowingCorDistance = 25.0;
-        break;
-      }
-      default:
-        NS_FATAL_ERROR ("Programming Error.");
+      return m_minLoss;
     }
-  }
-  else if (m_scenario == "Extended-V2V-Urban")
-  {
-    switch ((*it).second.m_channelCondition)
+
+  uint64_t key = LinkStateStore::GetKey (idA, idB);
+  uint32_t slot = m_linkStates.Find (key);
+  if (slot == LinkStateStore::INVALID_SLOT)
     {
-      case 'l':
-      {
-        lossDb = 38.77 + 16.7 * log10 (distance3D) + 18.2 * log10 (freqGHz);
-        shadowingStd = 3.0;
-        // The extended model does not specify the decorrelation distance. I
-        // assume the one specified by TR 36.885
-        shadowingCorDistance = 10.0;
-        break;
-      }
-      case 'v':
-      {
-        double additionalLoss = GetAdditionalNlosVLoss (distance3D, hA, hB);
-
-        lossDb = 38.77 + 16.7 * log10 (distance3D) + 18.2 * log10 (freqGHz) + additionalLoss;
-        break;
-      }
-      case 'n':
-      {
-        lossDb = 36.85 + 30 * log10 (distance3D) + 18.9 * log10 (freqGHz);
-        shadowingStd = 4.0;
-        // The extended model does not specify the decorrelation distance. I
-        // assume the one specified by TR 36.885
-        shadowingCorDistance = 10.0;
-        break;
-      }
-      default:
-        NS_FATAL_ERROR ("Programming Error.");
+      // assign a large negative value to identify initial transmission.
+      slot = m_linkStates.Insert (key, DrawChannelCondition (distance3D, hA, hB), -1e6, Simulator::Now ());
     }
-  }
-  else
+  char channelCondition = m_linkStates.GetCondition (slot);
+
+  const ConditionParams &params = GetConditionParams (channelCondition);
+  double lossDb = params.m_intercept + params.m_distanceCoeff * logDistance;
+  if (channelCondition == 'v')
     {
-      NS_FATAL_ERROR ("Unknown channel scenario");
+      lossDb += GetAdditionalNlosVLoss (distance3D, hA, hB);
     }
 
+  double shadowingStd = params.m_shadowingStd;
+  double shadowingCorDistance = params.m_shadowingCorDistance;
 
   if (m_shadowingEnabled)
     {
+      double shadowing;
 
-      channelCondition cond;
-      cond = (*it).second;
-
+      if (m_shadowingFieldEnabled)
+        {
+          // the field is shared by all the links, only the standard
+          // deviation depends on the channel condition
+          shadowing = shadowingStd > 0 ? shadowingStd * GetShadowingField ()->GetLinkValue (aPos, bPos) : 0.0;
+        }
       //The first transmission the shadowing is initialized as -1e6,
       //we perform this if check to identify the first transmission.
-      m_logNorVar->SetAttribute ("Sigma", DoubleValue (shadowingStd));
-
-      if ((*it).second.m_shadowing < -1e5)
+      else if (m_linkStates.GetShadowing (slot) < -1e5)
         {
-          cond.m_shadowing = m_norVar->GetValue () * shadowingStd;
+          shadowing = m_norVar->GetValue () * shadowingStd;
         
         }
       else
         {
           // For some reason they check the difference only for the first device
           //Keep that in mind if you want to keep one dev const
-          double deltaX = aPos.x - (*it).second.m_position.x;
-          double deltaY = aPos.y - (*it).second.m_position.y;
+          const Vector &lastPos = m_linkStates.GetPosition (slot);
+          double deltaX = aPos.x - lastPos.x;
+          double deltaY = aPos.y - lastPos.y;
           double disDiff = sqrt (deltaX * deltaX + deltaY * deltaY);
          
-          double R = exp (-1 * disDiff / shadowingCorDistance);
+          // the NLOSv condition of some scenarios has no shadowing, hence
+          // no decorrelation distance
+          double R = shadowingCorDistance > 0 ? exp (-1 * disDiff / shadowingCorDistance) : 0.0;
           
 
-          cond.m_shadowing = R * (*it).second.m_shadowing + sqrt (1 - R * R) * m_norVar->GetValue () * shadowingStd;
+          shadowing = R * m_linkStates.GetShadowing (slot) + sqrt (1 - R * R) * m_norVar->GetValue () * shadowingStd;
           
         }
 
-      lossDb += cond.m_shadowing;
-      
-      weatherAtten = GetWeatherAttenuation(distance3D, hA, hB);
+      lossDb += shadowing;
       
       lossDb += weatherAtten;
      
-      cond.m_position = deviceA->GetPosition ();
-      UpdateConditionMap (deviceA,deviceB,cond);
+      m_linkStates.Update (slot, shadowing, aPos, Simulator::Now ());
       
     }
+  else
+    {
+      m_linkStates.Touch (slot, Simulator::Now ());
+    }
 
 
   return std::max (lossDb, m_minLoss);
 }
 
+char
+MmWaveVehicularPropagationLossModel::DrawChannelCondition (double distance3D, double hA, double hB) const
+{
+  char condition = 0;
+
+  if (m_fixedCondition != 0)
+    {
+      condition = m_fixedCondition;
+      NS_LOG_UNCOND (m_scenario << " scenario, channel condition is fixed to be " << condition << ", h_A=" << hA << ",h_B=" << hB);
+    }
+  else
+    {
+      double PRef = m_uniformVar->GetValue ();
+      double probLos, probnLos, probnLosv;
+
+      switch (m_scenarioId)
+        {
+        case V2V_HIGHWAY:
+          {
+            double a, b, c;
+            a = 2.1013e-6;
+            b = - 0.002;
+            c = 1.0193;
+
+            if (distance3D <= 475)
+            {
+              probLos = std::min(1.0, a * pow(distance3D, 2) + b * distance3D + c);
+            }
+            else
+            {
+              probLos = std::max(0.0, 0.54 - 0.001 * (distance3D - 475));
+            }
+
+            if (PRef <= probLos)
+            {
+              condition = 'l';
+            }
+            else
+            {
+              condition = 'v';
+            }
+            break;
+          }
+        case V2V_URBAN:
+          {
+            probLos = std::min(1.0, 1.05 * exp(-0.0114 * distance3D));
+
+            if (PRef <= probLos)
+            {
+              condition = 'l';
+            }
+            else
+            {
+              condition = 'v';
+            }
+            break;
+          }
+        case EXTENDED_V2V_HIGHWAY:
+          {
+            // As established from TR 37.885 we  have to define
+            double aLOS, bLOS, cLOS = 1;
+            aLOS = 2.7e-6;
+            bLOS = - 0.0025;
+
+            probLos = std::min(1.0, std::max(0.0, aLOS * pow(distance3D, 2) + bLOS * distance3D + cLOS));
+
+            double aNLOS, bNLOS, cNLOS = 0.015;
+            aNLOS = -3.7e-7;
+            bNLOS = 0.00061;
+
+            probnLos = std::min(1.0, std::max(0.0, aNLOS * pow(distance3D, 2) + bNLOS * distance3D + cNLOS));
+
+            if (PRef <= probLos)
+              {
+                condition = 'l';
+              }
+            else if (PRef <= probLos + probnLos)
+              {
+                condition = 'n';
+              }
+            else
+              {
+                condition = 'v';
+              }
+            break;
+          }
+        case EXTENDED_V2V_URBAN:
+          {
+            probLos = std::min(1.0, std::max(0.0, 0.8372 * exp (-0.0114*distance3D)));
+            probnLosv = std::min(1.0, std::max(0.0, 1/(0.0312*distance3D) * exp(- pow(log(distance3D) - 5.0063, 2) / 2.4544)));
+
+            if (PRef <= probLos)
+              {
+                condition = 'l';
+              }
+            else if (PRef <= probLos + probnLosv)
+              {
+                condition = 'v';
+              }
+            else
+              {
+                condition = 'n';
+              }
+            break;
+          }
+        default:
+          NS_FATAL_ERROR ("Unknown scenario");
+        }
+
+      NS_LOG_DEBUG (m_scenario << " scenario, 3D distance = " << distance3D << "m, Prob_LOS = " << probLos
+                                << ", Prob_REF = " << PRef << ", the channel condition is " << condition << ", h_A=" << hA << ",h_B=" << hB);
+    }
+
+  return condition;
+}
+
 double
 MmWaveVehicularPropagationLossModel::GetAdditionalNlosVLoss (double distance3D, double hA, double hB) const
 {
@@ -542,7 +641,7 @@ MmWaveVehicularPropagationLossModel::GetAdditionalNlosVLoss (double distance3D,
     blockerHeight = 1.6;
     
   }
-  std::cout << "\n The blocker height is: " << blockerHeight << std::endl;
+  NS_LOG_LOGIC ("The blocker height is " << blockerHeight);
 
   // The additional blockage loss is max {0 dB, a log-normal random variable}
   if (std::min (hA, hB) > blockerHeight)
@@ -576,41 +675,38 @@ MmWaveVehicularPropagationLossModel::GetAdditionalNlosVLoss (double distance3D,
     m_logNorVar->SetAttribute ("Sigma", DoubleValue (sqrt(log10(pow(sigma_a,2) / pow(mu_a,2) + 1))));
     additionalLoss = std::max(0.0, m_logNorVar->GetValue());
   }
-std::cout<< "\n The additional loss is: " <<additionalLoss<<std::endl;
+  NS_LOG_LOGIC ("The additional loss is " << additionalLoss);
+  m_nlosvBlockageTrace (distance3D, blockerHeight, additionalLoss);
   return additionalLoss;
 }
 
 int64_t
 MmWaveVehicularPropagationLossModel::DoAssignStreams (int64_t stream)
 {
-  return 0;
-}
-
-void
-MmWaveVehicularPropagationLossModel::UpdateConditionMap (Ptr<MobilityModel> a, Ptr<MobilityModel> b, channelCondition cond) const
-{
-  m_channelConditionMap[std::make_pair (a,b)] = cond;
-  m_channelConditionMap[std::make_pair (b,a)] = cond;
-
+  m_norVar->SetStream (stream);
+  m_logNorVar->SetStream (stream + 1);
+  m_uniformVar->SetStream (stream + 2);
+  return 3;
 }
 
 char
 MmWaveVehicularPropagationLossModel::GetChannelCondition (Ptr<MobilityModel> a, Ptr<MobilityModel> b)
 {
-  channelConditionMap_t::const_iterator it;
-  it = m_channelConditionMap.find (std::make_pair (a,b));
-  if (it == m_channelConditionMap.end ())
+  uint32_t slot = m_linkStates.Find (LinkStateStore::GetKey (GetNodeId (a), GetNodeId (b)));
+  if (slot == LinkStateStore::INVALID_SLOT)
     {
       NS_FATAL_ERROR ("Cannot find the link in the map");
     }
-  return (*it).second.m_channelCondition;
+  return m_linkStates.GetCondition (slot);
 
 }
 
-std::string
-MmWaveVehicularPropagationLossModel::GetScenario ()
+void
+MmWaveVehicularPropagationLossModel::RemoveNode (uint32_t nodeId)
 {
-  return m_scenario;
+  NS_LOG_FUNCTION (this << nodeId);
+  uint32_t removed = m_linkStates.RemoveNode (nodeId);
+  NS_LOG_DEBUG ("Removed " << removed << " links of node " << nodeId);
 }
 
 } // namespace millicar
@@ -32,7 +32,12 @@
 #include <ns3/mmwave-phy-mac-common.h>
 #include <ns3/rain-snow-attenuation.h>
 #include <ns3/rain-attenuation.h>
-#include <map>
+#include <ns3/weather-attenuation.h>
+#include <ns3/link-state-store.h>
+#include <ns3/shadowing-field.h>
+#include <ns3/nstime.h>
+#include <ns3/traced-callback.h>
+#include <vector>
 
 /*
  * This propagation loss model for vehicular communications has been implemented based on the 3GPP TR 37.885 v15.2.0 (2019-01).
@@ -47,16 +52,6 @@ namespace ns3 {
 
 namespace millicar {
 
-struct channelCondition
-{
-  char m_channelCondition;
-  double m_shadowing;
-  Vector m_position;
-};
-
-// map store the path loss scenario(LOS,NLOS,OUTAGE) of each propagation channel
-typedef std::map< std::pair< Ptr<MobilityModel>, Ptr<MobilityModel> >, channelCondition> channelConditionMap_t;
-
 class MmWaveVehicularPropagationLossModel : public PropagationLossModel
 {
   public:
@@ -92,14 +87,103 @@ class MmWaveVehicularPropagationLossModel : public PropagationLossModel
      */
     double GetWeatherAttenuation (double distance3D, double hA, double hB) const;
 
+    /**
+     * \param a the mobility model of device A, aggregated to a node
+     * \param b the mobility model of device B, aggregated to a node
+     * \returns the channel condition of the link, which must have been used
+     *
+     * The links are identified by the ids of the nodes the mobility models
+     * are aggregated to; the simulation aborts if a model has no node.
+     */
     char GetChannelCondition (Ptr<MobilityModel> a, Ptr<MobilityModel> b);
 
-    std::string GetScenario ();
+    /**
+     * Forget the channel condition and the shadowing of all the links of a
+     * node, e.g., when the corresponding vehicle leaves the simulation
+     *
+     * \param nodeId the id of the node
+     */
+    void RemoveNode (uint32_t nodeId);
+
+    /**
+     * \param scenario one of 'V2V-Highway', 'V2V-Urban', 'Extended-V2V-Highway', 'Extended-V2V-Urban'
+     */
+    void SetScenario (std::string scenario);
+
+    /**
+     * \returns the channel scenario
+     */
+    std::string GetScenario (void) const;
+
+    /**
+     * \param condition 'l' for LOS, 'n' for NLOS, 'v' for NLOSv, 'a' for all
+     */
+    void SetChannelConditionMode (std::string condition);
+
+    /**
+     * \returns the channel condition configuration
+     */
+    std::string GetChannelConditionMode (void) const;
 
+    /**
+     * \param a the mobility model of device A, aggregated to a node
+     * \param b the mobility model of device B, aggregated to a node
+     * \returns the loss (dB) of the link
+     *
+     * The channel condition and the shadowing of a link are stored under the
+     * ids of the nodes the mobility models are aggregated to, hence the
+     * simulation aborts if a model has no node.
+     */
     double GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
 
+    /**
+     * Compute the loss between one transmitter and a set of receivers.
+     * The result is the same as calling GetLoss (tx, rx[i]) for each
+     * receiver in order, but the positions are read once and the
+     * distances, their logarithms and the weather attenuation are computed
+     * in loops over contiguous buffers. The random draws stay link by link,
+     * to keep the order of the scalar calls.
+     *
+     * \param tx the mobility model of the transmitter, aggregated to a node
+     * \param rx the mobility models of the receivers, aggregated to nodes
+     * \param lossDb buffer of at least rx.size () elements, filled with the loss (dB) of each link
+     */
+    void GetLoss (Ptr<MobilityModel> tx, const std::vector<Ptr<MobilityModel> > &rx, double *lossDb) const;
+
+    /**
+     * TracedCallback signature for the NLOSv vehicle blockage
+     *
+     * \param [in] distance3D the 3D distance between tx and rx
+     * \param [in] blockerHeight the height of the blocking vehicle
+     * \param [in] additionalLoss the additional blockage loss in dB
+     */
+    typedef void (* NlosvBlockageTracedCallback) (double distance3D, double blockerHeight, double additionalLoss);
+
   private:
 
+    /**
+     * The channel scenarios of TR 37.885
+     */
+    enum VehicularScenario
+    {
+      V2V_HIGHWAY,
+      V2V_URBAN,
+      EXTENDED_V2V_HIGHWAY,
+      EXTENDED_V2V_URBAN
+    };
+
+    /**
+     * Path loss and shadowing parameters of a channel condition, resolved
+     * when the scenario or the frequency is set
+     */
+    struct ConditionParams
+    {
+      double m_intercept; //!< constant term of the path loss (dB), including the frequency term
+      double m_distanceCoeff; //!< coefficient of log10 (distance3D)
+      double m_shadowingStd; //!< standard deviation of the shadowing (dB)
+      double m_shadowingCorDistance; //!< decorrelation distance of the shadowing (m)
+    };
+
     MmWaveVehicularPropagationLossModel (const MmWaveVehicularPropagationLossModel &o);
     MmWaveVehicularPropagationLossModel & operator = (const MmWaveVehicularPropagationLossModel &o);
 
@@ -107,7 +191,53 @@ class MmWaveVehicularPropagationLossModel : public PropagationLossModel
                                   Ptr<MobilityModel> a,
                                   Ptr<MobilityModel> b) const;
     virtual int64_t DoAssignStreams (int64_t stream);
-    void UpdateConditionMap (Ptr<MobilityModel> a, Ptr<MobilityModel> b, channelCondition cond) const;
+
+    /**
+     * Remove the link states which have not been used for m_linkStateTimeout
+     */
+    void SweepLinkStates (void) const;
+
+    /**
+     * \param idA the id of the node of device A
+     * \param idB the id of the node of device B
+     * \param aPos the position of device A
+     * \param bPos the position of device B
+     * \param distance3D the 3D distance between the devices
+     * \param logDistance log10 (distance3D)
+     * \param weatherAtten the weather attenuation (dB) of the link, only added with the shadowing
+     *
+     * \returns the loss (dB) of the link
+     */
+    double CalcLinkLoss (uint32_t idA, uint32_t idB, const Vector &aPos, const Vector &bPos,
+                         double distance3D, double logDistance, double weatherAtten) const;
+
+    /**
+     * Draw the channel condition of a new link
+     *
+     * \param distance3D: the 3D distance between tx and rx
+     * \param hA: the height of device A
+     * \param hB: the height of device B
+     *
+     * \returns the channel condition ('l', 'n' or 'v')
+     */
+    char DrawChannelCondition (double distance3D, double hA, double hB) const;
+
+    /**
+     * Compute the parameters of each channel condition for the current
+     * scenario and frequency
+     */
+    void UpdateConditionParams (void);
+
+    /**
+     * \param condition the channel condition ('l', 'n' or 'v')
+     * \returns the parameters of the channel condition
+     */
+    const ConditionParams & GetConditionParams (char condition) const;
+
+    /**
+     * \returns the shadowing field, created at the first call
+     */
+    Ptr<ShadowingField> GetShadowingField (void) const;
 
     /**
      * \param distance3D: the 3D distance between tx and rx
@@ -121,16 +251,33 @@ class MmWaveVehicularPropagationLossModel : public PropagationLossModel
     double m_frequency;
     double m_lambda;
     double m_minLoss;
-    mutable channelConditionMap_t m_channelConditionMap;
+    mutable LinkStateStore m_linkStates; //!< condition and shadowing of each link
+    Time m_linkStateTimeout; //!< links unused for this long are removed, zero disables the expiry
+    mutable Time m_lastLinkStateSweep; //!< time of the last removal of the idle links
+    mutable std::vector<double> m_batchX; //!< receiver x coordinates for the batch GetLoss
+    mutable std::vector<double> m_batchY; //!< receiver y coordinates for the batch GetLoss
+    mutable std::vector<double> m_batchZ; //!< receiver z coordinates for the batch GetLoss
+    mutable std::vector<double> m_batchDistance; //!< receiver distances for the batch GetLoss
+    mutable std::vector<double> m_batchLogDistance; //!< log10 of the receiver distances for the batch GetLoss
+    mutable std::vector<double> m_batchWeather; //!< weather attenuation of each link for the batch GetLoss
     std::string m_channelConditions;
-    std::string m_scenario;;
+    std::string m_scenario;
+    char m_fixedCondition; //!< the channel condition if fixed by m_channelConditions, 0 if drawn
+    VehicularScenario m_scenarioId; //!< the scenario corresponding to m_scenario
+    ConditionParams m_losParams; //!< parameters of the LOS condition
+    ConditionParams m_nlosParams; //!< parameters of the NLOS condition
+    ConditionParams m_nlosvParams; //!< parameters of the NLOSv condition
     bool m_optionNlosEnabled;
     Ptr<NormalRandomVariable> m_norVar;
     Ptr<LogNormalRandomVariable> m_logNorVar;
     Ptr<UniformRandomVariable> m_uniformVar;
     bool m_shadowingEnabled = true;
+    bool m_shadowingFieldEnabled = false; //!< true to use the shadowing field instead of the per-link shadowing
+    mutable Ptr<ShadowingField> m_shadowingField; //!< the shadowing field shared by all the links
     double m_percType3Vehicles = 30;
     bool m_snowEnabled = false;
+    Ptr<WeatherAttenuation> m_weatherAttenuation; //!< precomputed rain/snow attenuation
+    TracedCallback<double, double, double> m_nlosvBlockageTrace; //!< trace source for the NLOSv blockage
 };
 
 } // namespace millicar
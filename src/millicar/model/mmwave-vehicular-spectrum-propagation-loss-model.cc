@@ -93,6 +93,8 @@ static const double oxygen_loss[17][2] = {
 };
 
 MmWaveVehicularSpectrumPropagationLossModel::MmWaveVehicularSpectrumPropagationLossModel ()
+  : m_numExpiredChannels (0),
+    m_scattererMaxSpeed (0.0)
 {
   m_uniformRv = CreateObject<UniformRandomVariable> ();
   m_uniformRvBlockage = CreateObject<UniformRandomVariable> ();
@@ -165,6 +167,7 @@ void
 MmWaveVehicularSpectrumPropagationLossModel::DoDispose ()
 {
   NS_LOG_FUNCTION (this);
+  m_channelMap.clear ();
 }
 
 void
@@ -189,8 +192,6 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
   Ptr<NetDevice> txDevice = a->GetObject<Node> ()->GetDevice (0);
   Ptr<NetDevice> rxDevice = b->GetObject<Node> ()->GetDevice (0);
 
-  Vector locUT = b->GetPosition (); // TODO change this
-
   // retrieve the antenna of the tx device
   NS_ASSERT_MSG (m_deviceAntennaMap.find (txDevice) != m_deviceAntennaMap.end (), "Antenna not found for device " << txDevice);
   Ptr<MmWaveVehicularAntennaArrayModel> txAntennaArray = m_deviceAntennaMap.at (txDevice);
@@ -224,15 +225,22 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
 
   Vector rxSpeed = b->GetVelocity ();
   Vector txSpeed = a->GetVelocity ();
-  Vector relativeSpeed (rxSpeed.x - txSpeed.x,rxSpeed.y - txSpeed.y,rxSpeed.z - txSpeed.z);
-
-  key_t key = std::make_pair (txDevice,rxDevice);
-  key_t keyReverse = std::make_pair (rxDevice,txDevice);
 
+  // A single channel realization is stored for each pair of devices, in the
+  // orientation in which it was generated. The reverse link uses it by
+  // reciprocity, i.e., the channel matrix is transposed: its rx elements
+  // are those of the transmitter, and arrival and departure are exchanged.
+  key_t key = (txDevice < rxDevice) ? std::make_pair (txDevice,rxDevice) : std::make_pair (rxDevice,txDevice);
   std::map< key_t, Ptr<Params3gpp> >::iterator it = m_channelMap.find (key);
-  std::map< key_t, Ptr<Params3gpp> >::iterator itReverse = m_channelMap.find (keyReverse);
+
+  // the channel matrix expires UpdatePeriod after its generation
+  if (it != m_channelMap.end ())
+    {
+      CheckChannelExpiry (it->second);
+    }
 
   Ptr<Params3gpp> channelParams;
+  bool reverseLink = (it != m_channelMap.end () && it->second->m_txDevice != txDevice);
 
   //Step 2: Assign propagation condition (LOS/NLOS).
 
@@ -259,29 +267,34 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
   //When there is a LOS/NLOS switch, a new uncorrelated channel is created.
   //Therefore, LOS/NLOS condition of updating is always consistent with the previous channel.
 
-  //I only update the forward channel.
-  if ((it == m_channelMap.end () && itReverse == m_channelMap.end ())
-      || (it != m_channelMap.end () && it->second->m_channel.size () == 0)
-      || (it != m_channelMap.end () && it->second->m_condition != condition)
-      || (itReverse != m_channelMap.end () && itReverse->second->m_channel.size () == 0)
-      || (itReverse != m_channelMap.end () && itReverse->second->m_condition != condition))
+  //The channel is updated in the orientation in which it was generated.
+  if (it == m_channelMap.end ()
+      || it->second->m_channel.IsEmpty ()
+      || it->second->m_condition != condition)
     {
-      NS_LOG_INFO ("Update or create the forward channel");
-      NS_LOG_LOGIC ("it == m_channelMap.end () " << (it == m_channelMap.end ()));
-      NS_LOG_LOGIC ("itReverse == m_channelMap.end () " << (itReverse == m_channelMap.end ()));
-      NS_LOG_LOGIC ("it->second->m_channel.size() == 0 " << (it->second->m_channel.size () == 0));
-      NS_LOG_LOGIC ("it->second->m_condition != condition" << (it->second->m_condition != condition));
+      NS_LOG_INFO ("Update or create the channel, reverse link " << reverseLink);
+
+      Ptr<const MobilityModel> genTx = reverseLink ? b : a;
+      Ptr<const MobilityModel> genRx = reverseLink ? a : b;
+      Ptr<MmWaveVehicularAntennaArrayModel> genTxAntennaArray = reverseLink ? rxAntennaArray : txAntennaArray;
+      Ptr<MmWaveVehicularAntennaArrayModel> genRxAntennaArray = reverseLink ? txAntennaArray : rxAntennaArray;
+      uint16_t *genTxAntennaNum = reverseLink ? rxAntennaNum : txAntennaNum;
+      uint16_t *genRxAntennaNum = reverseLink ? txAntennaNum : rxAntennaNum;
+      Vector genLocUT = genRx->GetPosition ();
+      Vector genRxSpeed = genRx->GetVelocity ();
+      Vector genTxSpeed = genTx->GetVelocity ();
+      Vector relativeSpeed (genRxSpeed.x - genTxSpeed.x,genRxSpeed.y - genTxSpeed.y,genRxSpeed.z - genTxSpeed.z);
 
       //Step 1: The parameters are configured in the example code.
       /*make sure txAngle rxAngle exist, i.e., the position of tx and rx cannot be the same*/
-      Angles txAngle (b->GetPosition (), a->GetPosition ());
-      Angles rxAngle (a->GetPosition (), b->GetPosition ());
+      Angles txAngle (genRx->GetPosition (), genTx->GetPosition ());
+      Angles rxAngle (genTx->GetPosition (), genRx->GetPosition ());
       NS_LOG_DEBUG ("txAngle  " << txAngle.phi << " " << txAngle.theta);
       NS_LOG_DEBUG ("rxAngle " << rxAngle.phi << " " << rxAngle.theta);
 
-      txAngle.phi = txAngle.phi - txAntennaArray->GetOffset ();          //adjustment of the angles due to multi-sector consideration
+      txAngle.phi = txAngle.phi - genTxAntennaArray->GetOffset ();          //adjustment of the angles due to multi-sector consideration
       NS_LOG_DEBUG ("txAngle with offset PHI " << txAngle.phi);
-      rxAngle.phi = rxAngle.phi - rxAntennaArray->GetOffset ();
+      rxAngle.phi = rxAngle.phi - genRxAntennaArray->GetOffset ();
       NS_LOG_DEBUG ("rxAngle with offset PHI " << rxAngle.phi);
 
       //Step 2: Assign propagation condition (LOS/NLOS).
@@ -289,83 +302,94 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
 
       //Step 3: The propagation loss is handled in the mmWavePropagationLossModel class.
 
-      double x = a->GetPosition ().x - b->GetPosition ().x;
-      double y = a->GetPosition ().y - b->GetPosition ().y;
+      double x = genTx->GetPosition ().x - genRx->GetPosition ().x;
+      double y = genTx->GetPosition ().y - genRx->GetPosition ().y;
       double distance2D = sqrt (x * x + y * y);
-      double hTx = a->GetPosition ().z;
-      double hRx = b->GetPosition ().z;
 
       //Draw parameters from table 7.5-6 and 7.5-7 to 7.5-10.
-      Ptr<ParamsTable> table3gpp = Get3gppTable (condition, o2i, hTx, hRx, distance2D);
+      Ptr<const ParamsTable> table3gpp = Get3gppTable (condition);
 
       // Step 4-11 are performed in function GetNewChannel()
-      if ((it == m_channelMap.end () && itReverse == m_channelMap.end ())
-          || (it != m_channelMap.end () && it->second->m_channel.size () == 0))
-        {
-          //delete the channel parameter to cause the channel to be updated again.
-          //The m_updatePeriod can be configured to be relatively large in order to disable updates.
-          if (m_updatePeriod.GetMilliSeconds () > 0)
-            {
-              NS_LOG_INFO ("Time " << Simulator::Now ().GetSeconds () << " schedule delete for a " << a->GetPosition () << " b " << b->GetPosition ()
-                                   << " m_updatePeriod " << m_updatePeriod.GetSeconds ());
-              Simulator::Schedule (m_updatePeriod, &MmWaveVehicularSpectrumPropagationLossModel::DeleteChannel,this,a,b);
-            }
-        }
-
-      double distance3D = a->GetDistanceFrom (b);
+      double distance3D = genTx->GetDistanceFrom (genRx);
 
       bool channelUpdate = false;
-      if (it != m_channelMap.end () && it->second->m_channel.size () == 0)
+      if (it != m_channelMap.end () && it->second->m_channel.IsEmpty ())
         {
           //if the channel map is not empty, we only update the channel.
-          NS_LOG_DEBUG ("Update forward channel consistently between MobilityModel " << a << " " << b);
-          it->second->m_locUT = locUT;
+          NS_LOG_DEBUG ("Update channel consistently between MobilityModel " << genTx << " " << genRx);
+          it->second->m_locUT = genLocUT;
           it->second->m_condition = condition;
           it->second->m_o2i = o2i;
-          channelParams = UpdateChannel (it->second, table3gpp, txAntennaArray, rxAntennaArray,
-                                         txAntennaNum, rxAntennaNum, rxAngle, txAngle);
+          channelParams = UpdateChannel (it->second, table3gpp, genTxAntennaArray, genRxAntennaArray,
+                                         genTxAntennaNum, genRxAntennaNum, rxAngle, txAngle);
           it->second->m_dis3D = distance3D;
           it->second->m_dis2D = distance2D;
           it->second->m_speed = relativeSpeed;
           it->second->m_generatedTime = Now ();
-          it->second->m_preLocUT = locUT;
+          it->second->m_preLocUT = genLocUT;
           channelUpdate = true;
         }
       else
         {
           //if the channel map is empty, we create a new channel.
           NS_LOG_INFO ("Create new channel");
-          channelParams = GetNewChannel (table3gpp, locUT, condition, o2i, txAntennaArray, rxAntennaArray,
-                                         txAntennaNum, rxAntennaNum, rxAngle, txAngle, relativeSpeed, distance2D, distance3D);
+          channelParams = GetNewChannel (table3gpp, genLocUT, condition, o2i, genTxAntennaArray, genRxAntennaArray,
+                                         genTxAntennaNum, genRxAntennaNum, rxAngle, txAngle, relativeSpeed, distance2D, distance3D);
+          channelParams->m_txDevice = reverseLink ? rxDevice : txDevice;
         }
 
       NS_LOG_DEBUG (" --- UPDATE BF VECTOR and LONGTERM vectors --- for new or update? " << channelUpdate);
 
+      //the channel matrix expires after m_updatePeriod, causing the channel to be updated again.
+      //The m_updatePeriod can be configured to be relatively large in order to disable updates.
+      if (m_updatePeriod.GetMilliSeconds () > 0)
+        {
+          channelParams->m_expiryTime = channelParams->m_generatedTime + m_updatePeriod;
+        }
+
       // insert the channelParams in the map
       m_channelMap[key] = channelParams;
     }
-  else if (itReverse == m_channelMap.end ())                       // Find channel matrix in the forward link
+  else
     {
-      channelParams = (*it).second;
-      NS_LOG_DEBUG ("No need to update the channel");
+      channelParams = it->second;
+      NS_LOG_DEBUG ("No need to update the channel, reverse link " << reverseLink);
+    }
+
+  // the long term component is computed again only if the channel or one
+  // of the beams has changed since the last call for this link direction
+  LongTermCache &cache = channelParams->m_longTermCache[reverseLink ? 1 : 0];
+  if (!cache.m_valid
+      || cache.m_channelGeneration != channelParams->m_generation
+      || cache.m_txAntenna != PeekPointer (txAntennaArray)
+      || cache.m_rxAntenna != PeekPointer (rxAntennaArray)
+      || cache.m_txGeneration != txAntennaArray->GetBeamformingGeneration ()
+      || cache.m_rxGeneration != rxAntennaArray->GetBeamformingGeneration ())
+    {
+      // for now, store these BF vectors so that CalLongTerm can use them,
+      // m_rxW and m_txW are applied to the rx and tx elements of the
+      // channel matrix, which are exchanged on the reverse link
+      channelParams->m_txW = (reverseLink ? rxAntennaArray : txAntennaArray)->GetBeamformingVectorPanel ();
+      channelParams->m_rxW = (reverseLink ? txAntennaArray : rxAntennaArray)->GetBeamformingVectorPanel ();
+
+      // call CalLongTerm, and get the longTerm params
+      cache.m_longTerm = CalLongTerm (channelParams);
+      cache.m_valid = true;
+      cache.m_channelGeneration = channelParams->m_generation;
+      cache.m_txAntenna = PeekPointer (txAntennaArray);
+      cache.m_rxAntenna = PeekPointer (rxAntennaArray);
+      cache.m_txGeneration = txAntennaArray->GetBeamformingGeneration ();
+      cache.m_rxGeneration = rxAntennaArray->GetBeamformingGeneration ();
     }
-  else                       // Find channel matrix in the Reverse link
+  else
     {
-      channelParams = (*itReverse).second;
-
-      NS_LOG_DEBUG ("No need to update the channel");
+      NS_LOG_LOGIC ("Reuse the long term component");
     }
+  const complexVector_t &longTerm = cache.m_longTerm;
 
-  // for now, store these BF vectors so that CalLongTerm can use them
-  channelParams->m_txW = txAntennaArray->GetBeamformingVectorPanel ();
-  channelParams->m_rxW = rxAntennaArray->GetBeamformingVectorPanel ();
-
-  // call CalLongTerm, and get the longTerm params
-  auto longTerm = CalLongTerm (channelParams);
-
-  channelParams->m_longTerm = longTerm;
-
-  Ptr<SpectrumValue> bfPsd = CalBeamformingGain (rxPsd, channelParams, longTerm, rxSpeed, txSpeed);
+  // the arrival angles of the channel are those of its rx elements
+  Ptr<SpectrumValue> bfPsd = reverseLink ? CalBeamformingGain (rxPsd, channelParams, longTerm, txSpeed, rxSpeed)
+    : CalBeamformingGain (rxPsd, channelParams, longTerm, rxSpeed, txSpeed);
 
   SpectrumValue bfGain = (*bfPsd) / (*rxPsd);
   uint8_t nbands = bfGain.GetSpectrumModel ()->GetNumBands ();
@@ -380,7 +404,7 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
 
 Ptr<SpectrumValue>
 MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (Ptr<const SpectrumValue> txPsd, Ptr<Params3gpp> params,
-                                       complexVector_t longTerm, Vector rxSpeed, Vector txSpeed) const
+                                       const complexVector_t &longTerm, Vector rxSpeed, Vector txSpeed) const
 {
   NS_LOG_FUNCTION (this);
 
@@ -398,26 +422,17 @@ MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (Ptr<const Spect
   //uint8_t rxAntenna = params->m_rxW.size();
   //the update of Doppler is simplified by only taking the center angle of each cluster in to consideration.
   Values::iterator vit = tempPsd->ValuesBegin ();
-  Bands::const_iterator sbit = tempPsd->ConstBandsBegin(); // sub band iterator
 
   double slotTime = Simulator::Now ().GetSeconds ();
   complexVector_t doppler;
   for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
     {
 
-      double alpha = 0.0, D = 0.0, vScatt = 0.0, delayedPathsTerm = 0.0; // parameters used to evaluate Doppler effect in delayed paths as described in p. 32 of TR 37.885
+      double alpha = 0.0, D = 0.0, delayedPathsTerm = 0.0; // parameters used to evaluate Doppler effect in delayed paths as described in p. 32 of TR 37.885
 
       if(cIndex != 0)
         {
-         if(m_scenario == "V2V-Highway" || m_scenario == "Extended-V2V-Highway")
-         {
-          vScatt = 140/3.6; // maximum speed in highway scenario, converted in m/s to be consistent with other speed measures
-         }
-         else if (m_scenario == "V2V-Urban" || m_scenario == "Extended-V2V-Urban")
-         {
-          vScatt = 60/3.6; // maximum speed in urban scenario, converted in m/s to be consistent with other speed measures
-         }
-         D = m_uniformRv->GetValue(-vScatt, vScatt);
+         D = m_uniformRv->GetValue(-m_scattererMaxSpeed, m_scattererMaxSpeed);
          alpha = m_uniformRv->GetValue(0, 1);
          delayedPathsTerm = 2 * alpha * D;
         }
@@ -435,40 +450,108 @@ MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (Ptr<const Spect
 
     }
 
-  while (vit != tempPsd->ValuesEnd ())
+  UpdateSubbandFactors (params, tempPsd->GetSpectrumModel ());
+  const SubbandFactors &factors = params->m_subbandFactors;
+  size_t numBands = tempPsd->GetSpectrumModel ()->GetNumBands ();
+
+  // the gain of each subband is accumulated cluster by cluster, so that the
+  // inner loop runs over contiguous subbands
+  m_subbandGainReal.assign (numBands, 0.0);
+  m_subbandGainImag.assign (numBands, 0.0);
+  double *gainReal = &m_subbandGainReal[0];
+  double *gainImag = &m_subbandGainImag[0];
+  for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
+    {
+      std::complex<double> weight = longTerm.at (cIndex) * doppler.at (cIndex);
+      double wReal = weight.real ();
+      double wImag = weight.imag ();
+      const double *fReal = &factors.m_real[cIndex * numBands];
+      const double *fImag = &factors.m_imag[cIndex * numBands];
+      for (size_t bIndex = 0; bIndex < numBands; bIndex++)
+        {
+          gainReal[bIndex] += wReal * fReal[bIndex] - wImag * fImag[bIndex];
+          gainImag[bIndex] += wReal * fImag[bIndex] + wImag * fReal[bIndex];
+        }
+    }
+
+  for (size_t bIndex = 0; bIndex < numBands; bIndex++, vit++)
     {
-      std::complex<double> subsbandGain (0.0,0.0);
       if ((*vit) != 0.00)
         {
-          double fsb = (*sbit).fc;
-          for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
-            {
-              double delay = -2 * M_PI * fsb * (params->m_delay.at (cIndex));
-              double tauDelta = 0.0;
+          *vit = (*vit) * (gainReal[bIndex] * gainReal[bIndex] + gainImag[bIndex] * gainImag[bIndex]);
+        }
+    }
+  return tempPsd;
+}
 
-              if(cIndex != 0)
-              {
-                tauDelta = params->m_tauDelta; // when in LOS condition, tau_{\Delta} is equal to zero.
-              }
+void
+MmWaveVehicularSpectrumPropagationLossModel::UpdateSubbandFactors (Ptr<Params3gpp> params, Ptr<const SpectrumModel> model) const
+{
+  SubbandFactors &factors = params->m_subbandFactors;
+  if (factors.m_valid
+      && factors.m_channelGeneration == params->m_generation
+      && factors.m_modelUid == model->GetUid ()
+      && factors.m_oxygenAbsorption == m_oxygenAbsorption)
+    {
+      return;
+    }
+  NS_LOG_FUNCTION (this << params << model->GetUid ());
 
-              if(!m_oxygenAbsorption)
-              {
-                subsbandGain = subsbandGain + longTerm.at (cIndex) * doppler.at (cIndex) * exp (std::complex<double> (0, delay));
-              }
-              else
-              {
-                subsbandGain = subsbandGain + longTerm.at (cIndex) * doppler.at (cIndex) * exp (std::complex<double> (0, delay)) / GetOxygenLoss(fsb, params->m_dis3D, params->m_delay.at (cIndex), tauDelta);
-              }
+  uint8_t numCluster = params->m_numCluster;
+  size_t numBands = model->GetNumBands ();
+  doubleVector_t fc;
+  fc.reserve (numBands);
+  for (Bands::const_iterator bit = model->Begin (); bit != model->End (); bit++)
+    {
+      fc.push_back (bit->fc);
+    }
 
+  // with uniformly spaced subbands, exp (-j 2 pi (f0 + k df) tau) is
+  // obtained from the previous subband with one complex product, the
+  // phasor is computed again every g_phasorAnchorPeriod subbands to bound
+  // the accumulated rounding error
+  static const size_t g_phasorAnchorPeriod = 64;
+  double spacing = numBands > 1 ? (fc[numBands - 1] - fc[0]) / (numBands - 1) : 0.0;
+  bool uniform = numBands > 1 && spacing > 0;
+  for (size_t bIndex = 1; bIndex < numBands && uniform; bIndex++)
+    {
+      uniform = std::abs (fc[bIndex] - (fc[0] + bIndex * spacing)) <= 1e-6 * spacing;
+    }
+
+  factors.m_real.resize (numCluster * numBands);
+  factors.m_imag.resize (numCluster * numBands);
+  for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
+    {
+      double tau = params->m_delay.at (cIndex);
+      double tauDelta = (cIndex != 0) ? params->m_tauDelta : 0.0; // when in LOS condition, tau_{\Delta} is equal to zero.
+      std::complex<double> step = exp (std::complex<double> (0, -2 * M_PI * spacing * tau));
+      std::complex<double> phasor;
+      for (size_t bIndex = 0; bIndex < numBands; bIndex++)
+        {
+          if (!uniform || bIndex % g_phasorAnchorPeriod == 0)
+            {
+              phasor = exp (std::complex<double> (0, -2 * M_PI * fc[bIndex] * tau));
             }
-          *vit = (*vit) * (norm (subsbandGain));
+          else
+            {
+              phasor *= step;
+            }
+
+          std::complex<double> factor = phasor;
+          if (m_oxygenAbsorption)
+            {
+              factor /= GetOxygenLoss (fc[bIndex], params->m_dis3D, tau, tauDelta);
+            }
+          factors.m_real[cIndex * numBands + bIndex] = factor.real ();
+          factors.m_imag[cIndex * numBands + bIndex] = factor.imag ();
         }
-      vit++;
-      sbit++;
     }
-  return tempPsd;
-}
 
+  factors.m_valid = true;
+  factors.m_channelGeneration = params->m_generation;
+  factors.m_modelUid = model->GetUid ();
+  factors.m_oxygenAbsorption = m_oxygenAbsorption;
+}
 
 double
 MmWaveVehicularSpectrumPropagationLossModel::GetOxygenLoss (double f, double dist3D, double tau, double tauDelta) const
@@ -502,6 +585,21 @@ MmWaveVehicularSpectrumPropagationLossModel::SetPathlossModel (Ptr<PropagationLo
   if (DynamicCast<MmWaveVehicularPropagationLossModel> (m_3gppPathloss) != 0)
     {
       m_scenario = m_3gppPathloss->GetObject<MmWaveVehicularPropagationLossModel> ()->GetScenario ();
+      // maximum speed of the scatterers, converted in m/s to be consistent
+      // with other speed measures
+      if (m_scenario == "V2V-Highway" || m_scenario == "Extended-V2V-Highway")
+        {
+          m_scattererMaxSpeed = 140 / 3.6;
+        }
+      else if (m_scenario == "V2V-Urban" || m_scenario == "Extended-V2V-Urban")
+        {
+          m_scattererMaxSpeed = 60 / 3.6;
+        }
+      else
+        {
+          m_scattererMaxSpeed = 0.0;
+        }
+      Update3gppTables ();
     }
   // else if (DynamicCast<MmWave3gppBuildingsPropagationLossModel> (m_3gppPathloss) != 0)
   //   {
@@ -523,29 +621,66 @@ MmWaveVehicularSpectrumPropagationLossModel::CalLongTerm (Ptr<Params3gpp> params
   NS_LOG_DEBUG ("CalLongTerm with txAntenna " << (uint16_t)txAntenna << " rxAntenna " << (uint16_t)rxAntenna);
   //store the long term part to reduce computation load
   //only the small scale fading is need to be updated if the large scale parameters and antenna weights remain unchanged.
-  complexVector_t longTerm;
+  complexVector_t longTerm (params->m_numCluster, std::complex<double> (0,0));
   uint8_t numCluster = params->m_numCluster;
+  const complexTensor_t &channel = params->m_channel;
+  NS_ASSERT_MSG (channel.GetDim (0) == rxAntenna && channel.GetDim (1) == txAntenna
+                 && channel.GetDim (2) >= numCluster, "The channel matrix does not match the antenna weights");
+  NS_ASSERT (channel.GetLayout () == complexTensor_t::ROW_MAJOR);
 
-  for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
+  // rxSum[s][n] accumulates the rx combining of H[u][s][n] over u, the
+  // clusters of each tx antenna are contiguous in the channel matrix.
+  complexVector_t rxSum (txAntenna * numCluster, std::complex<double> (0,0));
+  for (uint16_t rxIndex = 0; rxIndex < rxAntenna; rxIndex++)
     {
-      std::complex<double> txSum (0,0);
+      std::complex<double> rxW = params->m_rxW[rxIndex];
       for (uint16_t txIndex = 0; txIndex < txAntenna; txIndex++)
         {
-          std::complex<double> rxSum (0,0);
-          for (uint16_t rxIndex = 0; rxIndex < rxAntenna; rxIndex++)
+          const std::complex<double> *H_n = &channel (rxIndex, txIndex, 0);
+          std::complex<double> *sum = &rxSum[txIndex * numCluster];
+          for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
             {
-              rxSum = rxSum + params->m_rxW.at (rxIndex) * params->m_channel.at (rxIndex).at (txIndex).at (cIndex);
+              sum[cIndex] = sum[cIndex] + rxW * H_n[cIndex];
             }
-          txSum = txSum + params->m_txW.at (txIndex) * rxSum;
         }
-      longTerm.push_back (txSum);
+    }
+  for (uint16_t txIndex = 0; txIndex < txAntenna; txIndex++)
+    {
+      std::complex<double> txW = params->m_txW[txIndex];
+      const std::complex<double> *sum = &rxSum[txIndex * numCluster];
+      for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
+        {
+          longTerm[cIndex] = longTerm[cIndex] + txW * sum[cIndex];
+        }
     }
   return longTerm;
 
 }
 
+Ptr<const ParamsTable>
+MmWaveVehicularSpectrumPropagationLossModel::Get3gppTable (char condition) const
+{
+  std::map<char, Ptr<const ParamsTable> >::const_iterator it = m_table3gppMap.find (condition);
+  NS_ASSERT_MSG (it != m_table3gppMap.end (), "No ParamsTable for condition " << condition << ", set the pathloss model and the frequency first");
+  return it->second;
+}
+
+void
+MmWaveVehicularSpectrumPropagationLossModel::Update3gppTables (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_table3gppMap.clear ();
+  if (m_frequency == 0.0 || m_scenario.empty ())
+    {
+      return;
+    }
+  m_table3gppMap['l'] = Compute3gppTable ('l');
+  m_table3gppMap['n'] = Compute3gppTable ('n');
+  m_table3gppMap['v'] = Compute3gppTable ('v');
+}
+
 Ptr<ParamsTable>
-MmWaveVehicularSpectrumPropagationLossModel::Get3gppTable (char condition, bool o2i, double hBS, double hUT, double distance2D) const
+MmWaveVehicularSpectrumPropagationLossModel::Compute3gppTable (char condition) const
 {
   double fcGHz = m_frequency / 1e9;
   Ptr<ParamsTable> table3gpp = CreateObject<ParamsTable> ();
@@ -774,22 +909,27 @@ MmWaveVehicularSpectrumPropagationLossModel::Get3gppTable (char condition, bool
 }
 
 void
-MmWaveVehicularSpectrumPropagationLossModel::DeleteChannel (Ptr<const MobilityModel> a, Ptr<const MobilityModel> b) const
+MmWaveVehicularSpectrumPropagationLossModel::CheckChannelExpiry (Ptr<Params3gpp> params) const
 {
-  NS_LOG_FUNCTION (this);
-  Ptr<NetDevice> dev1 = a->GetObject<Node> ()->GetDevice (0);
-  Ptr<NetDevice> dev2 = b->GetObject<Node> ()->GetDevice (0);
-  NS_LOG_INFO ("a position " << a->GetPosition () << " b " << b->GetPosition ());
-  Ptr<Params3gpp> params = m_channelMap.find (std::make_pair (dev1,dev2))->second;
-  NS_LOG_INFO ("params " << params);
-  NS_LOG_INFO ("params m_channel size" << params->m_channel.size ());
-  NS_ASSERT_MSG (m_channelMap.find (std::make_pair (dev1,dev2)) != m_channelMap.end (), "Channel not found");
-  params->m_channel.clear ();
-  m_channelMap[std::make_pair (dev1,dev2)] = params;
+  if (Now () >= params->m_expiryTime)
+    {
+      NS_LOG_INFO ("Time " << Simulator::Now ().GetSeconds () << " delete channel " << params
+                           << " generated at " << params->m_generatedTime.GetSeconds ());
+      // the memory of the channel matrix is kept for the next update
+      params->m_channel.Clear ();
+      params->m_expiryTime = Time::Max ();
+      m_numExpiredChannels++;
+    }
+}
+
+uint64_t
+MmWaveVehicularSpectrumPropagationLossModel::GetNumExpiredChannels (void) const
+{
+  return m_numExpiredChannels;
 }
 
 Ptr<Params3gpp>
-MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<ParamsTable>  table3gpp, Vector locUT, char condition, bool o2i,
+MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<const ParamsTable>  table3gpp, Vector locUT, char condition, bool o2i,
                                   Ptr<MmWaveVehicularAntennaArrayModel> txAntenna, Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna,
                                   uint16_t *txAntennaNum, uint16_t *rxAntennaNum,  Angles &rxAngle, Angles &txAngle,
                                   Vector speed, double dis2D, double dis3D) const
@@ -1358,8 +1498,6 @@ MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<ParamsTable>  ta
 
   complex3DVector_t H_NLOS;       // channel coefficients H_NLOS [u][s][n],
   // where u and s are receive and transmit antenna element, n is cluster index.
-  uint64_t uSize = rxAntennaNum[0] * rxAntennaNum[1];
-  uint64_t sSize = txAntennaNum[0] * txAntennaNum[1];
 
   uint8_t cluster1st = 0, cluster2nd = 0;       // first and second strongest cluster;
   double maxPower = 0;
@@ -1383,170 +1521,16 @@ MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<ParamsTable>  ta
 
   NS_LOG_INFO ("1st strongest cluster:" << (int)cluster1st << ", 2nd strongest cluster:" << (int)cluster2nd);
 
-  complex3DVector_t H_usn;       //channel coffecient H_usn[u][s][n];
+  //channel coffecient H_usn[u][s][n];
   //Since each of the strongest 2 clusters are divided into 3 sub-clusters, the total cluster will be numReducedCLuster + 4.
-
-  H_usn.resize (uSize);
-  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
-    {
-      H_usn.at (uIndex).resize (sSize);
-      for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
-        {
-          H_usn.at (uIndex).at (sIndex).resize (numReducedCluster);
-        }
-    }
-  //double slotTime = Simulator::Now ().GetSeconds ();
-  // The following for loops computes the channel coefficients
-  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
-    {
-      Vector uLoc = rxAntenna->GetAntennaLocation (uIndex,rxAntennaNum);
-
-      for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
-        {
-
-          Vector sLoc = txAntenna->GetAntennaLocation (sIndex,txAntennaNum);
-
-          for (uint8_t nIndex = 0; nIndex < numReducedCluster; nIndex++)
-            {
-              //Compute the N-2 weakest cluster, only vertical polarization. (7.5-22)
-              if (nIndex != cluster1st && nIndex != cluster2nd)
-                {
-                  std::complex<double> rays (0,0);
-                  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
-                    {
-                      double initialPhase = clusterPhase.at (nIndex).at (mIndex);
-                      //lambda_0 is accounted in the antenna spacing uLoc and sLoc.
-                      double rxPhaseDiff = 2 * M_PI * (sin (rayZoa_radian[nIndex][mIndex]) * cos (rayAoa_radian[nIndex][mIndex]) * uLoc.x
-                                                       + sin (rayZoa_radian[nIndex][mIndex]) * sin (rayAoa_radian[nIndex][mIndex]) * uLoc.y
-                                                       + cos (rayZoa_radian[nIndex][mIndex]) * uLoc.z);
-
-                      double txPhaseDiff = 2 * M_PI * (sin (rayZod_radian[nIndex][mIndex]) * cos (rayAod_radian[nIndex][mIndex]) * sLoc.x
-                                                       + sin (rayZod_radian[nIndex][mIndex]) * sin (rayAod_radian[nIndex][mIndex]) * sLoc.y
-                                                       + cos (rayZod_radian[nIndex][mIndex]) * sLoc.z);
-                      //Doppler is computed in the CalBeamformingGain function and is simplified to only account for the center anngle of each cluster.
-                      //double doppler = 2*M_PI*(sin(rayZoa_radian[nIndex][mIndex])*cos(rayAoa_radian[nIndex][mIndex])*relativeSpeed.x
-                      //		+ sin(rayZoa_radian[nIndex][mIndex])*sin(rayAoa_radian[nIndex][mIndex])*relativeSpeed.y
-                      //		+ cos(rayZoa_radian[nIndex][mIndex])*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-                      rays += exp (std::complex<double> (0, initialPhase))
-                        * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                           * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                        * exp (std::complex<double> (0, rxPhaseDiff))
-                        * exp (std::complex<double> (0, txPhaseDiff));
-                      //*exp(std::complex<double>(0, doppler));
-                      //rays += 1;
-                    }
-                  //rays *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  rays *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) = rays;
-                }
-              else                   //(7.5-28)
-                {
-                  std::complex<double> raysSub1 (0,0);
-                  std::complex<double> raysSub2 (0,0);
-                  std::complex<double> raysSub3 (0,0);
-
-                  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
-                    {
-
-                      //ZML:Just remind me that the angle offsets for the 3 subclusters were not generated correctly.
-
-                      double initialPhase = clusterPhase.at (nIndex).at (mIndex);
-                      double rxPhaseDiff = 2 * M_PI * (sin (rayZoa_radian[nIndex][mIndex]) * cos (rayAoa_radian[nIndex][mIndex]) * uLoc.x
-                                                       + sin (rayZoa_radian[nIndex][mIndex]) * sin (rayAoa_radian[nIndex][mIndex]) * uLoc.y
-                                                       + cos (rayZoa_radian[nIndex][mIndex]) * uLoc.z);
-                      double txPhaseDiff = 2 * M_PI * (sin (rayZod_radian[nIndex][mIndex]) * cos (rayAod_radian[nIndex][mIndex]) * sLoc.x
-                                                       + sin (rayZod_radian[nIndex][mIndex]) * sin (rayAod_radian[nIndex][mIndex]) * sLoc.y
-                                                       + cos (rayZod_radian[nIndex][mIndex]) * sLoc.z);
-                      //double doppler = 2*M_PI*(sin(rayZoa_radian[nIndex][mIndex])*cos(rayAoa_radian[nIndex][mIndex])*relativeSpeed.x
-                      //		+ sin(rayZoa_radian[nIndex][mIndex])*sin(rayAoa_radian[nIndex][mIndex])*relativeSpeed.y
-                      //		+ cos(rayZoa_radian[nIndex][mIndex])*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-                      //double delaySpread;
-                      switch (mIndex)
-                        {
-                        case 9:
-                        case 10:
-                        case 11:
-                        case 12:
-                        case 17:
-                        case 18:
-                          //delaySpread= -2*M_PI*(clusterDelay.at(nIndex)+1.28*c_DS)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub2 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub2 +=1;
-                          break;
-                        case 13:
-                        case 14:
-                        case 15:
-                        case 16:
-                          //delaySpread = -2*M_PI*(clusterDelay.at(nIndex)+2.56*c_DS)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub3 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub3 +=1;
-                          break;
-                        default:                        //case 1,2,3,4,5,6,7,8,19,20
-                                                        //delaySpread = -2*M_PI*clusterDelay.at(nIndex)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub1 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub1 +=1;
-                          break;
-                        }
-                    }
-                  //raysSub1 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  //raysSub2 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  //raysSub3 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  raysSub1 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  raysSub2 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  raysSub3 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) = raysSub1;
-                  H_usn.at (uIndex).at (sIndex).push_back (raysSub2);
-                  H_usn.at (uIndex).at (sIndex).push_back (raysSub3);
-
-                }
-            }
-          if (condition == 'l')               //(7.5-29) && (7.5-30)
-            {
-              std::complex<double> ray (0,0);
-              double rxPhaseDiff = 2 * M_PI * (sin (rxAngle.theta) * cos (rxAngle.phi) * uLoc.x
-                                               + sin (rxAngle.theta) * sin (rxAngle.phi) * uLoc.y
-                                               + cos (rxAngle.theta) * uLoc.z);
-              double txPhaseDiff = 2 * M_PI * (sin (txAngle.theta) * cos (txAngle.phi) * sLoc.x
-                                               + sin (txAngle.theta) * sin (txAngle.phi) * sLoc.y
-                                               + cos (txAngle.theta) * sLoc.z);
-              //double doppler = 2*M_PI*(sin(rxAngle.theta)*cos(rxAngle.phi)*relativeSpeed.x
-              //		+ sin(rxAngle.theta)*sin(rxAngle.phi)*relativeSpeed.y
-              //		+ cos(rxAngle.theta)*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-
-              ray = exp (std::complex<double> (0, losPhase))
-                * (rxAntenna->GetRadiationPattern (rxAngle.theta,rxAngle.phi)
-                   * txAntenna->GetRadiationPattern (txAngle.theta,rxAngle.phi))
-                * exp (std::complex<double> (0, rxPhaseDiff))
-                * exp (std::complex<double> (0, txPhaseDiff));
-              //*exp(std::complex<double>(0, doppler));
-
-              double K_linear = pow (10,K_factor / 10);
-              // the LOS path should be attenuated if blockage is enabled.
-              H_usn.at (uIndex).at (sIndex).at (0) = sqrt (1 / (K_linear + 1)) * H_usn.at (uIndex).at (sIndex).at (0) + sqrt (K_linear / (1 + K_linear)) * ray / pow (10,attenuation_dB.at (0) / 10);           //(7.5-30) for tau = tau1
-              double tempSize = H_usn.at (uIndex).at (sIndex).size ();
-              for (uint8_t nIndex = 1; nIndex < tempSize; nIndex++)
-                {
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) *= sqrt (1 / (K_linear + 1));                   //(7.5-30) for tau = tau2...taunN
-                }
-
-            }
-        }
-    }
+  complexTensor_t &H_usn = channelParams->m_channel;
+  double losPatternGain = rxAntenna->GetRadiationPattern (rxAngle.theta,rxAngle.phi)
+    * txAntenna->GetRadiationPattern (txAngle.theta,rxAngle.phi);
+  CalChannelCoefficients (rxAntenna, txAntenna, rxAntennaNum, txAntennaNum, numReducedCluster, raysPerCluster,
+                          &rayAoa_radian[0][0], &rayZoa_radian[0][0], &rayAod_radian[0][0], &rayZod_radian[0][0],
+                          clusterPhase, clusterPower, cluster1st, cluster2nd,
+                          condition == 'l', losPhase, losPatternGain, rxAngle, txAngle, K_factor, attenuation_dB.at (0), H_usn);
+  channelParams->m_generation++;
 
   if (cluster1st == cluster2nd)
     {
@@ -1606,7 +1590,7 @@ MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<ParamsTable>  ta
 
     }
 
-  NS_LOG_INFO ("size of coefficient matrix =[" << H_usn.size () << "][" << H_usn.at (0).size () << "][" << H_usn.at (0).at (0).size () << "]");
+  NS_LOG_INFO ("size of coefficient matrix =[" << H_usn.GetDim (0) << "][" << H_usn.GetDim (1) << "][" << H_usn.GetDim (2) << "]");
 
 
   /*std::cout << "Delay:";
@@ -1616,7 +1600,6 @@ MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<ParamsTable>  ta
   }
   std::cout << "\n";*/
 
-  channelParams->m_channel = H_usn;
   channelParams->m_delay = clusterDelay;
 
   channelParams->m_angle.clear ();
@@ -1630,7 +1613,7 @@ MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<ParamsTable>  ta
 }
 
 Ptr<Params3gpp>
-MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> params3gpp, Ptr<ParamsTable>  table3gpp,
+MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> params3gpp, Ptr<const ParamsTable>  table3gpp,
                                   Ptr<MmWaveVehicularAntennaArrayModel> txAntenna, Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna,
                                   uint16_t *txAntennaNum, uint16_t *rxAntennaNum, Angles &rxAngle, Angles &txAngle) const
 {
@@ -2015,8 +1998,6 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
 
   complex3DVector_t H_NLOS;       // channel coefficients H_NLOS [u][s][n],
   // where u and s are receive and transmit antenna element, n is cluster index.
-  uint64_t uSize = rxAntennaNum[0] * rxAntennaNum[1];
-  uint64_t sSize = txAntennaNum[0] * txAntennaNum[1];
 
   uint8_t cluster1st = 0, cluster2nd = 0;       // first and second strongest cluster;
   double maxPower = 0;
@@ -2040,167 +2021,16 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
 
   NS_LOG_INFO ("1st strongest cluster:" << (int)cluster1st << ", 2nd strongest cluster:" << (int)cluster2nd);
 
-  complex3DVector_t H_usn;       //channel coffecient H_usn[u][s][n];
+  //channel coffecient H_usn[u][s][n], the buffer of the previous channel is reused;
   //Since each of the strongest 2 clusters are divided into 3 sub-clusters, the total cluster will be numReducedCLuster + 4.
-
-  H_usn.resize (uSize);
-  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
-    {
-      H_usn.at (uIndex).resize (sSize);
-      for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
-        {
-          H_usn.at (uIndex).at (sIndex).resize (params->m_numCluster);
-        }
-    }
-  //double slotTime = Simulator::Now ().GetSeconds ();
-  // The following for loops computes the channel coefficients
-  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
-    {
-      Vector uLoc = rxAntenna->GetAntennaLocation (uIndex,rxAntennaNum);
-
-      for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
-        {
-
-          Vector sLoc = txAntenna->GetAntennaLocation (sIndex,txAntennaNum);
-
-          for (uint8_t nIndex = 0; nIndex < params->m_numCluster; nIndex++)
-            {
-              //Compute the N-2 weakest cluster, only vertical polarization. (7.5-22)
-              if (nIndex != cluster1st && nIndex != cluster2nd)
-                {
-                  std::complex<double> rays (0,0);
-                  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
-                    {
-                      double initialPhase = clusterPhase.at (nIndex).at (mIndex);
-                      //lambda_0 is accounted in the antenna spacing uLoc and sLoc.
-                      double rxPhaseDiff = 2 * M_PI * (sin (rayZoa_radian[nIndex][mIndex]) * cos (rayAoa_radian[nIndex][mIndex]) * uLoc.x
-                                                       + sin (rayZoa_radian[nIndex][mIndex]) * sin (rayAoa_radian[nIndex][mIndex]) * uLoc.y
-                                                       + cos (rayZoa_radian[nIndex][mIndex]) * uLoc.z);
-
-                      double txPhaseDiff = 2 * M_PI * (sin (rayZod_radian[nIndex][mIndex]) * cos (rayAod_radian[nIndex][mIndex]) * sLoc.x
-                                                       + sin (rayZod_radian[nIndex][mIndex]) * sin (rayAod_radian[nIndex][mIndex]) * sLoc.y
-                                                       + cos (rayZod_radian[nIndex][mIndex]) * sLoc.z);
-                      //Doppler is computed in the CalBeamformingGain function and is simplified to only account for the center anngle of each cluster.
-                      //double doppler = 2*M_PI*(sin(rayZoa_radian[nIndex][mIndex])*cos(rayAoa_radian[nIndex][mIndex])*relativeSpeed.x
-                      //		+ sin(rayZoa_radian[nIndex][mIndex])*sin(rayAoa_radian[nIndex][mIndex])*relativeSpeed.y
-                      //		+ cos(rayZoa_radian[nIndex][mIndex])*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-                      rays += exp (std::complex<double> (0, initialPhase))
-                        * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                           * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                        * exp (std::complex<double> (0, rxPhaseDiff))
-                        * exp (std::complex<double> (0, txPhaseDiff));
-                      //*exp(std::complex<double>(0, doppler));
-                      //rays += 1;
-                    }
-                  //rays *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  rays *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) = rays;
-                }
-              else                   //(7.5-28)
-                {
-                  std::complex<double> raysSub1 (0,0);
-                  std::complex<double> raysSub2 (0,0);
-                  std::complex<double> raysSub3 (0,0);
-
-                  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
-                    {
-                      double initialPhase = clusterPhase.at (nIndex).at (mIndex);
-                      double rxPhaseDiff = 2 * M_PI * (sin (rayZoa_radian[nIndex][mIndex]) * cos (rayAoa_radian[nIndex][mIndex]) * uLoc.x
-                                                       + sin (rayZoa_radian[nIndex][mIndex]) * sin (rayAoa_radian[nIndex][mIndex]) * uLoc.y
-                                                       + cos (rayZoa_radian[nIndex][mIndex]) * uLoc.z);
-                      double txPhaseDiff = 2 * M_PI * (sin (rayZod_radian[nIndex][mIndex]) * cos (rayAod_radian[nIndex][mIndex]) * sLoc.x
-                                                       + sin (rayZod_radian[nIndex][mIndex]) * sin (rayAod_radian[nIndex][mIndex]) * sLoc.y
-                                                       + cos (rayZod_radian[nIndex][mIndex]) * sLoc.z);
-                      //double doppler = 2*M_PI*(sin(rayZoa_radian[nIndex][mIndex])*cos(rayAoa_radian[nIndex][mIndex])*relativeSpeed.x
-                      //		+ sin(rayZoa_radian[nIndex][mIndex])*sin(rayAoa_radian[nIndex][mIndex])*relativeSpeed.y
-                      //		+ cos(rayZoa_radian[nIndex][mIndex])*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-                      //double delaySpread;
-                      switch (mIndex)
-                        {
-                        case 9:
-                        case 10:
-                        case 11:
-                        case 12:
-                        case 17:
-                        case 18:
-                          //delaySpread= -2*M_PI*(clusterDelay.at(nIndex)+1.28*c_DS)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub2 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub2 +=1;
-                          break;
-                        case 13:
-                        case 14:
-                        case 15:
-                        case 16:
-                          //delaySpread = -2*M_PI*(clusterDelay.at(nIndex)+2.56*c_DS)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub3 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub3 +=1;
-                          break;
-                        default:                        //case 1,2,3,4,5,6,7,8,19,20
-                                                        //delaySpread = -2*M_PI*clusterDelay.at(nIndex)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub1 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub1 +=1;
-                          break;
-                        }
-                    }
-                  //raysSub1 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  //raysSub2 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  //raysSub3 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  raysSub1 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  raysSub2 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  raysSub3 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) = raysSub1;
-                  H_usn.at (uIndex).at (sIndex).push_back (raysSub2);
-                  H_usn.at (uIndex).at (sIndex).push_back (raysSub3);
-
-                }
-            }
-          if (params->m_condition == 'l')               //(7.5-29) && (7.5-30)
-            {
-              std::complex<double> ray (0,0);
-              double rxPhaseDiff = 2 * M_PI * (sin (rxAngle.theta) * cos (rxAngle.phi) * uLoc.x
-                                               + sin (rxAngle.theta) * sin (rxAngle.phi) * uLoc.y
-                                               + cos (rxAngle.theta) * uLoc.z);
-              double txPhaseDiff = 2 * M_PI * (sin (txAngle.theta) * cos (txAngle.phi) * sLoc.x
-                                               + sin (txAngle.theta) * sin (txAngle.phi) * sLoc.y
-                                               + cos (txAngle.theta) * sLoc.z);
-              //double doppler = 2*M_PI*(sin(rxAngle.theta)*cos(rxAngle.phi)*relativeSpeed.x
-              //		+ sin(rxAngle.theta)*sin(rxAngle.phi)*relativeSpeed.y
-              //		+ cos(rxAngle.theta)*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-
-              ray = exp (std::complex<double> (0, losPhase))
-                * (rxAntenna->GetRadiationPattern (rxAngle.theta,rxAngle.phi)
-                   * txAntenna->GetRadiationPattern (txAngle.theta,txAngle.phi))
-                * exp (std::complex<double> (0, rxPhaseDiff))
-                * exp (std::complex<double> (0, txPhaseDiff));
-              //*exp(std::complex<double>(0, doppler));
-
-              double K_linear = pow (10,K_factor / 10);
-
-              H_usn.at (uIndex).at (sIndex).at (0) = sqrt (1 / (K_linear + 1)) * H_usn.at (uIndex).at (sIndex).at (0) + sqrt (K_linear / (1 + K_linear)) * ray / pow (10,attenuation_dB.at (0) / 10);           //(7.5-30) for tau = tau1
-              double tempSize = H_usn.at (uIndex).at (sIndex).size ();
-              for (uint8_t nIndex = 1; nIndex < tempSize; nIndex++)
-                {
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) *= sqrt (1 / (K_linear + 1));                   //(7.5-30) for tau = tau2...taunN
-                }
-
-            }
-        }
-    }
+  complexTensor_t &H_usn = params->m_channel;
+  double losPatternGain = rxAntenna->GetRadiationPattern (rxAngle.theta,rxAngle.phi)
+    * txAntenna->GetRadiationPattern (txAngle.theta,txAngle.phi);
+  CalChannelCoefficients (rxAntenna, txAntenna, rxAntennaNum, txAntennaNum, params->m_numCluster, raysPerCluster,
+                          &rayAoa_radian[0][0], &rayZoa_radian[0][0], &rayAod_radian[0][0], &rayZod_radian[0][0],
+                          clusterPhase, clusterPower, cluster1st, cluster2nd,
+                          params->m_condition == 'l', losPhase, losPatternGain, rxAngle, txAngle, K_factor, attenuation_dB.at (0), H_usn);
+  params->m_generation++;
 
   if (cluster1st == cluster2nd)
     {
@@ -2243,7 +2073,7 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
 
     }
 
-  NS_LOG_INFO ("size of coefficient matrix =[" << H_usn.size () << "][" << H_usn.at (0).size () << "][" << H_usn.at (0).at (0).size () << "]");
+  NS_LOG_INFO ("size of coefficient matrix =[" << H_usn.GetDim (0) << "][" << H_usn.GetDim (1) << "][" << H_usn.GetDim (2) << "]");
 
 
   /*std::cout << "Delay:";
@@ -2254,7 +2084,6 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
   std::cout << "\n";*/
 
   params->m_delay = clusterDelay;
-  params->m_channel = H_usn;
   params->m_angle.clear ();
   params->m_angle.push_back (clusterAoa);
   params->m_angle.push_back (clusterZoa);
@@ -2266,6 +2095,177 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
 
 }
 
+void
+MmWaveVehicularSpectrumPropagationLossModel::CalChannelCoefficients (Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna, Ptr<MmWaveVehicularAntennaArrayModel> txAntenna,
+                                                                     uint16_t *rxAntennaNum, uint16_t *txAntennaNum,
+                                                                     uint8_t numCluster, uint8_t raysPerCluster,
+                                                                     const double *rayAoa, const double *rayZoa, const double *rayAod, const double *rayZod,
+                                                                     const double2DVector_t &clusterPhase, const doubleVector_t &clusterPower,
+                                                                     uint8_t cluster1st, uint8_t cluster2nd,
+                                                                     bool los, double losPhase, double losPatternGain, const Angles &rxAngle, const Angles &txAngle,
+                                                                     double K_factor, double losAttenuationDb, complexTensor_t &H_usn) const
+{
+  NS_LOG_FUNCTION (this);
+
+  uint64_t uSize = rxAntennaNum[0] * rxAntennaNum[1];
+  uint64_t sSize = txAntennaNum[0] * txAntennaNum[1];
+  uint32_t numRays = numCluster * raysPerCluster;
+
+  // Per-ray terms, independent of the antenna elements: the direction
+  // vectors (scaled by 2*pi, lambda_0 is accounted in the antenna spacing)
+  // and the initial phase weighted by the radiation patterns.
+  doubleVector_t rxDirX (numRays), rxDirY (numRays), rxDirZ (numRays);
+  doubleVector_t txDirX (numRays), txDirY (numRays), txDirZ (numRays);
+  complexVector_t rayWeight (numRays);
+  for (uint8_t nIndex = 0; nIndex < numCluster; nIndex++)
+    {
+      for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
+        {
+          uint32_t k = nIndex * raysPerCluster + mIndex;
+          rxDirX[k] = 2 * M_PI * sin (rayZoa[k]) * cos (rayAoa[k]);
+          rxDirY[k] = 2 * M_PI * sin (rayZoa[k]) * sin (rayAoa[k]);
+          rxDirZ[k] = 2 * M_PI * cos (rayZoa[k]);
+          txDirX[k] = 2 * M_PI * sin (rayZod[k]) * cos (rayAod[k]);
+          txDirY[k] = 2 * M_PI * sin (rayZod[k]) * sin (rayAod[k]);
+          txDirZ[k] = 2 * M_PI * cos (rayZod[k]);
+          rayWeight[k] = exp (std::complex<double> (0, clusterPhase.at (nIndex).at (mIndex)))
+            * (rxAntenna->GetRadiationPattern (rayZoa[k],rayAoa[k])
+               * txAntenna->GetRadiationPattern (rayZod[k],rayAod[k]));
+        }
+    }
+
+  // Per-element phase terms: the phase of a ray at an element is the dot
+  // product of its direction with the element location. The rx term also
+  // includes the weight of the ray.
+  complexVector_t rxTerm (uSize * numRays);
+  complexVector_t txTerm (sSize * numRays);
+  complexVector_t rxLosTerm (uSize);
+  complexVector_t txLosTerm (sSize);
+  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
+    {
+      Vector uLoc = rxAntenna->GetAntennaLocation (uIndex,rxAntennaNum);
+      for (uint32_t k = 0; k < numRays; k++)
+        {
+          double rxPhaseDiff = rxDirX[k] * uLoc.x + rxDirY[k] * uLoc.y + rxDirZ[k] * uLoc.z;
+          rxTerm[uIndex * numRays + k] = rayWeight[k] * std::complex<double> (cos (rxPhaseDiff), sin (rxPhaseDiff));
+        }
+      if (los)
+        {
+          double rxPhaseDiff = 2 * M_PI * (sin (rxAngle.theta) * cos (rxAngle.phi) * uLoc.x
+                                           + sin (rxAngle.theta) * sin (rxAngle.phi) * uLoc.y
+                                           + cos (rxAngle.theta) * uLoc.z);
+          rxLosTerm[uIndex] = exp (std::complex<double> (0, rxPhaseDiff));
+        }
+    }
+  for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
+    {
+      Vector sLoc = txAntenna->GetAntennaLocation (sIndex,txAntennaNum);
+      for (uint32_t k = 0; k < numRays; k++)
+        {
+          double txPhaseDiff = txDirX[k] * sLoc.x + txDirY[k] * sLoc.y + txDirZ[k] * sLoc.z;
+          txTerm[sIndex * numRays + k] = std::complex<double> (cos (txPhaseDiff), sin (txPhaseDiff));
+        }
+      if (los)
+        {
+          double txPhaseDiff = 2 * M_PI * (sin (txAngle.theta) * cos (txAngle.phi) * sLoc.x
+                                           + sin (txAngle.theta) * sin (txAngle.phi) * sLoc.y
+                                           + cos (txAngle.theta) * sLoc.z);
+          txLosTerm[sIndex] = exp (std::complex<double> (0, txPhaseDiff));
+        }
+    }
+
+  // The two strongest clusters are divided into 3 sub-clusters (7.5-28),
+  // the rays of sub-cluster 2 and 3 are those listed below.
+  std::vector<uint8_t> subCluster (raysPerCluster, 0);
+  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
+    {
+      switch (mIndex)
+        {
+        case 9:
+        case 10:
+        case 11:
+        case 12:
+        case 17:
+        case 18:
+          subCluster[mIndex] = 1;
+          break;
+        case 13:
+        case 14:
+        case 15:
+        case 16:
+          subCluster[mIndex] = 2;
+          break;
+        default:                        //case 1,2,3,4,5,6,7,8,19,20
+          subCluster[mIndex] = 0;
+          break;
+        }
+    }
+
+  doubleVector_t clusterScale (numCluster);
+  for (uint8_t nIndex = 0; nIndex < numCluster; nIndex++)
+    {
+      clusterScale[nIndex] = sqrt (clusterPower.at (nIndex) / raysPerCluster);
+    }
+  double K_linear = pow (10,K_factor / 10);
+
+  // each of the strongest clusters adds two sub-clusters, which are stored
+  // after the numCluster clusters
+  uint32_t totalCluster = numCluster + (cluster1st == cluster2nd ? 2 : 4);
+  NS_ASSERT (H_usn.GetLayout () == complexTensor_t::ROW_MAJOR);
+  H_usn.Resize (uSize, sSize, totalCluster);
+  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
+    {
+      const std::complex<double> *rxRow = &rxTerm[uIndex * numRays];
+      for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
+        {
+          const std::complex<double> *txRow = &txTerm[sIndex * numRays];
+          std::complex<double> *H_n = &H_usn (uIndex, sIndex, 0);
+          uint32_t subClusterIndex = numCluster;
+
+          for (uint8_t nIndex = 0; nIndex < numCluster; nIndex++)
+            {
+              const std::complex<double> *rxRay = rxRow + nIndex * raysPerCluster;
+              const std::complex<double> *txRay = txRow + nIndex * raysPerCluster;
+
+              //Compute the N-2 weakest cluster, only vertical polarization. (7.5-22)
+              if (nIndex != cluster1st && nIndex != cluster2nd)
+                {
+                  std::complex<double> rays (0,0);
+                  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
+                    {
+                      rays += rxRay[mIndex] * txRay[mIndex];
+                    }
+                  H_n[nIndex] = rays * clusterScale[nIndex];
+                }
+              else                   //(7.5-28)
+                {
+                  std::complex<double> raysSub[3] = {0.0, 0.0, 0.0};
+                  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
+                    {
+                      raysSub[subCluster[mIndex]] += rxRay[mIndex] * txRay[mIndex];
+                    }
+                  H_n[nIndex] = raysSub[0] * clusterScale[nIndex];
+                  H_n[subClusterIndex++] = raysSub[1] * clusterScale[nIndex];
+                  H_n[subClusterIndex++] = raysSub[2] * clusterScale[nIndex];
+                }
+            }
+
+          if (los)               //(7.5-29) && (7.5-30)
+            {
+              std::complex<double> ray = exp (std::complex<double> (0, losPhase)) * losPatternGain
+                * rxLosTerm[uIndex] * txLosTerm[sIndex];
+
+              // the LOS path should be attenuated if blockage is enabled.
+              H_n[0] = sqrt (1 / (K_linear + 1)) * H_n[0] + sqrt (K_linear / (1 + K_linear)) * ray / pow (10,losAttenuationDb / 10);           //(7.5-30) for tau = tau1
+              for (uint32_t nIndex = 1; nIndex < totalCluster; nIndex++)
+                {
+                  H_n[nIndex] *= sqrt (1 / (K_linear + 1));                   //(7.5-30) for tau = tau2...taunN
+                }
+            }
+        }
+    }
+}
+
 doubleVector_t
 MmWaveVehicularSpectrumPropagationLossModel::CalAttenuationOfBlockage (Ptr<Params3gpp> params,
                                              doubleVector_t clusterAOA, doubleVector_t clusterZOA) const
@@ -2487,6 +2487,7 @@ void
 MmWaveVehicularSpectrumPropagationLossModel::SetFrequency (double freq)
 {
   m_frequency = freq;
+  Update3gppTables ();
 }
 
 double
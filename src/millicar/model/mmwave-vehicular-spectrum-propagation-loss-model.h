@@ -37,6 +37,7 @@
 #include <ns3/mmwave-phy-mac-common.h>
 #include <ns3/mmwave-vehicular-propagation-loss-model.h>
 #include <ns3/mmwave-vehicular-antenna-array-model.h>
+#include <ns3/channel-tensor.h>
 // #include <ns3/mmwave-3gpp-buildings-propagation-loss-model.h>
 
 #define AOA_INDEX 0
@@ -50,6 +51,8 @@
 #define Y_INDEX 3
 #define R_INDEX 4
 
+class MmWaveVehicularSubbandFactorsTestCase;
+
 namespace ns3 {
 
 namespace millicar {
@@ -62,21 +65,55 @@ typedef std::vector<doubleVector_t> double2DVector_t;
 typedef std::vector< std::complex<double> > complexVector_t;
 typedef std::vector<complexVector_t> complex2DVector_t;
 typedef std::vector<complex2DVector_t> complex3DVector_t;
+typedef Tensor3D< std::complex<double> > complexTensor_t;
 
 typedef std::pair<Ptr<NetDevice>, Ptr<NetDevice> > key_t;
 
+/**
+ * Long term component computed for a pair of beamforming vectors, with the
+ * generations of the channel and of the beams it was computed from
+ */
+struct LongTermCache
+{
+  bool m_valid = false;                                        // true if m_longTerm has been computed
+  const MmWaveVehicularAntennaArrayModel *m_txAntenna = 0;     // tx antenna of the beam
+  const MmWaveVehicularAntennaArrayModel *m_rxAntenna = 0;     // rx antenna of the beam
+  uint64_t m_txGeneration = 0;                                 // generation of the tx beam
+  uint64_t m_rxGeneration = 0;                                 // generation of the rx beam
+  uint64_t m_channelGeneration = 0;                            // generation of the channel matrix
+  complexVector_t m_longTerm;                                  // long term component
+};
+
+/**
+ * Frequency response of the clusters over the subbands of a spectrum model,
+ * i.e., exp (-j 2 pi f tau_n) divided by the oxygen loss, if enabled, with
+ * the generation of the channel it was computed from
+ */
+struct SubbandFactors
+{
+  bool m_valid = false;                                        // true if the factors have been computed
+  uint64_t m_channelGeneration = 0;                            // generation of the channel matrix
+  SpectrumModelUid_t m_modelUid = 0;                           // uid of the spectrum model
+  bool m_oxygenAbsorption = false;                             // true if the oxygen loss is included
+  doubleVector_t m_real;                                       // real part, indexed by cluster * numBands + band
+  doubleVector_t m_imag;                                       // imaginary part, indexed by cluster * numBands + band
+};
+
 /**
  * Data structure that stores a channel realization
  */
 struct Params3gpp : public SimpleRefCount<Params3gpp>
 {
-  complexVector_t                 m_txW;            // tx antenna weights.
-  complexVector_t                 m_rxW;            // rx antenna weights.
-  complex3DVector_t               m_channel;        // channel matrix H[u][s][n].
+  uint64_t                        m_generation = 0; // incremented every time m_channel is generated.
+  Ptr<NetDevice>                  m_txDevice;       // device of the tx elements of m_channel, the reverse link uses its transpose.
+  LongTermCache                   m_longTermCache[2]; // long term component for the forward and the reverse link.
+  SubbandFactors                  m_subbandFactors; // frequency response of the clusters, see CalBeamformingGain.
+  complexVector_t                 m_txW;            // antenna weights of the tx elements of m_channel.
+  complexVector_t                 m_rxW;            // antenna weights of the rx elements of m_channel.
+  complexTensor_t                 m_channel;        // channel matrix H[u][s][n].
   doubleVector_t                  m_delay;          // cluster delay.
   double                          m_tauDelta;       // minimum delay as indicated in 7.6-1 TR 38.901.
   double2DVector_t                m_angle;          // cluster angle angle[direction][n], where direction = 0(aoa), 1(zoa), 2(aod), 3(zod) in degree.
-  complexVector_t                 m_longTerm;       // long term component.
 
   double2DVector_t                m_nonSelfBlocking;       // store the blockages
 
@@ -85,6 +122,7 @@ struct Params3gpp : public SimpleRefCount<Params3gpp>
   Vector m_locUT;       // location of UT
   double2DVector_t m_norRvAngles;       //stores the normal variable for random angles angle[cluster][id] generated for equation (7.6-11)-(7.6-14), where id = 0(aoa),1(zoa),2(aod),3(zod)
   Time m_generatedTime;
+  Time m_expiryTime = Time::Max ();       // time at which m_channel is deleted, UpdatePeriod after m_generatedTime
   double m_DS;       // delay spread
   double m_K;       //K factor
   uint8_t m_numCluster;       // reduced cluster number;
@@ -168,6 +206,8 @@ struct ParamsTable : public Object
  */
 class MmWaveVehicularSpectrumPropagationLossModel : public SpectrumPropagationLossModel
 {
+  friend class ::MmWaveVehicularSubbandFactorsTestCase;
+
 public:
   /**
 * Constructor
@@ -205,6 +245,12 @@ public:
    */
   double GetFrequency (void) const;
 
+  /**
+   * \returns the number of channel expirations, each of which used to
+   *          require a scheduled DeleteChannel event
+   */
+  uint64_t GetNumExpiredChannels (void) const;
+
 
 private:
   /**
@@ -235,7 +281,7 @@ private:
    * @params the 3D distance between tx and rx
    * @returns the channel realization in a Params3gpp object
    */
-  Ptr<Params3gpp> GetNewChannel (Ptr<ParamsTable> table3gpp, Vector locUT, char condition, bool o2i,
+  Ptr<Params3gpp> GetNewChannel (Ptr<const ParamsTable> table3gpp, Vector locUT, char condition, bool o2i,
                                  Ptr<MmWaveVehicularAntennaArrayModel> txAntenna, Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna,
                                  uint16_t *txAntennaNum, uint16_t *rxAntennaNum, Angles &rxAngle, Angles &txAngle,
                                  Vector speed, double dis2D, double dis3D) const;
@@ -253,10 +299,44 @@ private:
    * @params the txAngle
    * @returns the channel realization in a Params3gpp object
    */
-  Ptr<Params3gpp> UpdateChannel (Ptr<Params3gpp> params3gpp, Ptr<ParamsTable> table3gpp,
+  Ptr<Params3gpp> UpdateChannel (Ptr<Params3gpp> params3gpp, Ptr<const ParamsTable> table3gpp,
                                  Ptr<MmWaveVehicularAntennaArrayModel> txAntenna, Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna,
                                  uint16_t *txAntennaNum, uint16_t *rxAntennaNum, Angles &rxAngle, Angles &txAngle) const;
 
+  /**
+   * Compute the channel coefficients H[u][s][n] of Step 11 of TR 38.901 Sec 7.5.
+   * The direction vectors, the radiation pattern gains and the initial phases
+   * of the rays do not depend on the antenna elements, hence they are computed
+   * once, as well as the per-element phase terms, and the coefficients are
+   * obtained by accumulating their products.
+   * @params the ArrayAntennaModel for the rxAntenna
+   * @params the ArrayAntennaModel for the txAntenna
+   * @params the number of rxAntenna per row
+   * @params the number of txAntenna per row
+   * @params the number of clusters
+   * @params the number of rays per cluster
+   * @params the ray angles in radians, indexed by n * raysPerCluster + m: AOA, ZOA, AOD and ZOD
+   * @params the initial phase of each ray
+   * @params the cluster powers
+   * @params the first and the second strongest cluster
+   * @params true if the LOS component has to be added
+   * @params the initial phase of the LOS ray
+   * @params the product of the rx and tx radiation patterns in the LOS direction
+   * @params the rxAngle
+   * @params the txAngle
+   * @params the K factor (dB)
+   * @params the blockage attenuation of the first cluster (dB)
+   * @params the tensor filled with the channel coefficients H[u][s][n], its memory is reused
+   */
+  void CalChannelCoefficients (Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna, Ptr<MmWaveVehicularAntennaArrayModel> txAntenna,
+                               uint16_t *rxAntennaNum, uint16_t *txAntennaNum,
+                               uint8_t numCluster, uint8_t raysPerCluster,
+                               const double *rayAoa, const double *rayZoa, const double *rayAod, const double *rayZod,
+                               const double2DVector_t &clusterPhase, const doubleVector_t &clusterPower,
+                               uint8_t cluster1st, uint8_t cluster2nd,
+                               bool los, double losPhase, double losPatternGain, const Angles &rxAngle, const Angles &txAngle,
+                               double K_factor, double losAttenuationDb, complexTensor_t &H_usn) const;
+
   /**
    * Compute and return the long term fading params in order to decrease the computational load
    * @params the channel realizationin as a Params3gpp object
@@ -276,10 +356,21 @@ private:
    */
   Ptr<SpectrumValue> CalBeamformingGain (Ptr<const SpectrumValue> txPsd,
                                          Ptr<Params3gpp> params,
-                                         complexVector_t longTerm,
+                                         const complexVector_t &longTerm,
                                          Vector rxSpeed,
                                          Vector txSpeed) const;
 
+  /**
+   * Compute the frequency response of each cluster over the subbands of a
+   * spectrum model, if the channel, the spectrum model or the oxygen
+   * absorption setting have changed since the last call. If the subbands are
+   * uniformly spaced, the delay phasors are obtained by a recurrence across
+   * the subbands.
+   * @params the channel realization
+   * @params the spectrum model
+   */
+  void UpdateSubbandFactors (Ptr<Params3gpp> params, Ptr<const SpectrumModel> model) const;
+
   /**
    * Returns the loss associated to the oxygen absorption as described in p. 43 of TR 38.901
    * @returns a double corresponding to the loss associated to the oxygen absorption
@@ -301,25 +392,35 @@ private:
 
   /**
    * Returns the ParamsTable with the parameters of TR 38.900 Table 7.5-6
-   * that apply to a certain scenario
+   * that apply to the current scenario and frequency. The tables are
+   * computed once by Update3gppTables, since they depend only on the
+   * scenario, the channel condition and the frequency.
    * @params the channel condition
-   * @params the o2i condition
-   * @params the BS height (i.e., eNB)
-   * @params the UT height (i.e., UE)
-   * @params the 2D distance
    * @return the ParamsTable structure
    */
-  Ptr<ParamsTable> Get3gppTable (char condition, bool o2i,
-                                 double hBS, double hUT, double distance2D) const;
+  Ptr<const ParamsTable> Get3gppTable (char condition) const;
 
   /**
-   * Delete the m_channel entry associated to the Params3gpp object of pair (a,b)
-   * but keep the other parameters, so that the spatial consistency procedure can be used
-   * @params the mobility model of the transmitter
-   * @params the mobility model of the receiver
+   * Build a new ParamsTable with the parameters of TR 38.900 Table 7.5-6
+   * that apply to the current scenario and frequency
+   * @params the channel condition
+   * @return the ParamsTable structure
+   */
+  Ptr<ParamsTable> Compute3gppTable (char condition) const;
+
+  /**
+   * Compute the ParamsTable of every channel condition, once both the
+   * scenario and the frequency are known
+   */
+  void Update3gppTables (void);
+
+  /**
+   * If the expiry time of the channel matrix has been reached, i.e.,
+   * UpdatePeriod has elapsed since it was generated, delete it but keep the
+   * other parameters, so that the spatial consistency procedure can be used
+   * @params the channel realization
    */
-  void DeleteChannel (Ptr<const MobilityModel> a,
-                      Ptr<const MobilityModel> b) const;
+  void CheckChannelExpiry (Ptr<Params3gpp> params) const;
   /*
    * Returns the attenuation of each cluster in dB after applying blockage model
    * @params the channel realizationin as a Params3gpp object
@@ -329,7 +430,10 @@ private:
   doubleVector_t CalAttenuationOfBlockage (Ptr<Params3gpp> params,
                                            doubleVector_t clusterAOA, doubleVector_t clusterZOA) const;
 
-  mutable std::map< key_t, Ptr<Params3gpp> > m_channelMap;
+  mutable std::map< key_t, Ptr<Params3gpp> > m_channelMap; // channel of each pair of devices, the key is ordered
+  mutable uint64_t m_numExpiredChannels; // number of channel matrices deleted after UpdatePeriod
+  mutable doubleVector_t m_subbandGainReal; // scratch vector of CalBeamformingGain
+  mutable doubleVector_t m_subbandGainImag; // scratch vector of CalBeamformingGain
 
   double m_frequency; // operating frequency in Hz
 
@@ -342,13 +446,14 @@ private:
   Ptr<ExponentialRandomVariable> m_expRv;
 
   Ptr<PropagationLossModel> m_3gppPathloss;
-  Ptr<ParamsTable> m_table3gpp;
+  std::map<char, Ptr<const ParamsTable> > m_table3gppMap; // ParamsTable of each channel condition
   Time m_updatePeriod;
   bool m_blockage;
   uint16_t m_numNonSelfBloking;               //number of non-self-blocking regions.
   bool m_portraitMode;                        //true (portrait mode); false (landscape mode).
   bool m_oxygenAbsorption;                    //true (consider oxygen absorption); false (do not consider oxygen absorption effects - default).
   std::string m_scenario;
+  double m_scattererMaxSpeed;                 //maximum speed of the scatterers in the scenario (m/s).
   double m_blockerSpeed;
   bool m_interferenceOrDataMode;
   bool m_o2i; // true if outdoor to indoor propagation
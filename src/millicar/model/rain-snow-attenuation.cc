@@ -20,14 +20,13 @@
  */
 
 #include "rain-snow-attenuation.h"
-#include <fstream>
 #include <math.h>
 #include <ns3/double.h>
 #include <ns3/log.h>
 #include <ns3/simulator.h>
 #include <ns3/uinteger.h>
-#include <stdio.h>
 #include <string>
+#include <vector>
 
 
 NS_LOG_COMPONENT_DEFINE("RainSnowAttenuation");
@@ -88,7 +87,33 @@ double RainSnowAttenuation::getRainHeight(double hTx, double hRx,
   return linkHeight;
 }
 
-double RainSnowAttenuation::getAttenuationMultiplier(double deltaHeight) {
+/**
+ * Table 1 of ITU-R P.530-15: probability of the rain height being in each
+ * of the 49 intervals of 100 m around the mean rain height, from
+ * -2400 m to +2400 m (the same values are listed in rainHeight_prob.txt).
+ */
+static const uint32_t g_numRainHeightIntervals = 49;
+static const double g_rainHeightProb[g_numRainHeightIntervals] = {
+    0.000555, 0.000802, 0.001139, 0.001594, 0.002196, 0.002978, 0.003976,
+    0.005227, 0.006764, 0.008617, 0.010808, 0.013346, 0.016225, 0.019419,
+    0.022881, 0.026542, 0.030312, 0.034081, 0.037724, 0.041110, 0.044104,
+    0.046583, 0.048439, 0.049588, 0.049977, 0.049588, 0.048439, 0.046583,
+    0.044104, 0.041110, 0.037724, 0.034081, 0.030312, 0.026542, 0.022881,
+    0.019419, 0.016225, 0.013346, 0.010808, 0.008617, 0.006764, 0.005227,
+    0.003976, 0.002978, 0.002196, 0.001594, 0.001139, 0.000802, 0.000555};
+
+/**
+ * The multiplying factor depends only on the link height relative to the
+ * mean rain height. Below -3600 m every interval contributes with a
+ * multiplier of 1, above +2400 m with a multiplier of 0, so the sum over
+ * the 49 intervals is tabulated in between with a step of
+ * g_snowFactorStep meters.
+ */
+static const double g_snowFactorMinHeight = -3600;
+static const double g_snowFactorMaxHeight = 2400;
+static const double g_snowFactorStep = 1;
+
+static double AttenuationMultiplier(double deltaHeight) {
   double attenMultiplier = 0;
   if (deltaHeight > 0) {
     attenMultiplier = 0;
@@ -106,6 +131,42 @@ double RainSnowAttenuation::getAttenuationMultiplier(double deltaHeight) {
   return attenMultiplier;
 }
 
+static double SnowAttenFactor(double relativeHeight) {
+  double multFactor = 0;
+  for (uint32_t i = 0; i < g_numRainHeightIntervals; i++) {
+    // Rain height of the interval, relative to the mean rain height
+    double rainHeight = -2400 + 100 * i;
+
+    // Link height relative to the rain height
+    double deltaHeight = relativeHeight - rainHeight;
+
+    // Add the multiplying factor for each interval
+    multFactor += AttenuationMultiplier(deltaHeight) * g_rainHeightProb[i];
+  }
+  return multFactor;
+}
+
+/**
+ * Returns the table of the multiplying factor, built the first time it is
+ * needed and shared by all the instances.
+ */
+static const std::vector<double> &GetSnowAttenFactorTable(void) {
+  static std::vector<double> table;
+  if (table.empty()) {
+    uint32_t numPoints = static_cast<uint32_t>(
+        (g_snowFactorMaxHeight - g_snowFactorMinHeight) / g_snowFactorStep) + 1;
+    table.resize(numPoints);
+    for (uint32_t i = 0; i < numPoints; i++) {
+      table[i] = SnowAttenFactor(g_snowFactorMinHeight + i * g_snowFactorStep);
+    }
+  }
+  return table;
+}
+
+double RainSnowAttenuation::getAttenuationMultiplier(double deltaHeight) {
+  return AttenuationMultiplier(deltaHeight);
+}
+
 /**
  * Computes the multiplying factor
  * Input:
@@ -118,52 +179,49 @@ double RainSnowAttenuation::getAttenuationMultiplier(double deltaHeight) {
 
 double RainSnowAttenuation::getSnowAttenFactor(double meanRainHeight,
                                                double linkHeight) {
-  double x, y;
-  int i;
-  double prob[49];
-  double multFactor = 0;
-
-  /**
-   * First, load the table of the propabilities given in
-   * Table 1 of ITU-R P.530-15.
-   * The rain height variability is modeled by taking 49
-   * intervals of 100 m relative to the mean rain height.
-   *
-   */
+  const std::vector<double> &table = GetSnowAttenFactorTable();
 
-  std::ifstream rainHeightProb;
-  rainHeightProb.open("src/millicar/model/rainHeight_prob.txt");
-  if (!rainHeightProb) {
-    printf("\n Unable to open the file");
-    exit(1);
+  double relativeHeight = linkHeight - meanRainHeight;
+  if (relativeHeight <= g_snowFactorMinHeight) {
+    return table.front();
+  }
+  if (relativeHeight >= g_snowFactorMaxHeight) {
+    return table.back();
   }
-  i = 0;
-  while (!rainHeightProb.eof()) {
-    rainHeightProb >> x >> y;
-    prob[i] = y;
-
-    // Do the following calculation for each interval
-    // Calculate the rain height -> rainHeight
-    double rainHeight = meanRainHeight - 2400 + 100 * i;
 
-    // Calculate the link height relative to the rain height
-    double deltaHeight = linkHeight - rainHeight;
+  double pos = (relativeHeight - g_snowFactorMinHeight) / g_snowFactorStep;
+  uint32_t idx = static_cast<uint32_t>(pos);
+  double frac = pos - idx;
+  return table[idx] + frac * (table[idx + 1] - table[idx]);
+}
+/**
+ * Computes the factor applied to the rain attenuation
+ * Input:
+ * - distance: distance between the transmitter and receiver
+ * - hTx: meters above the sea level of the first terminal
+ * - hRx: meters above the sea level of the second terminal
+ * Output:
+ * - multiplier: 1 if the link is not affected by the wet snow, the
+ *   multiplying factor of ITU-R P.530 otherwise
+ */
 
-    // Calculate the addition to the multiplying factor
-    double attenuationMultiplyingFact = getAttenuationMultiplier(deltaHeight);
+double RainSnowAttenuation::getSnowMultiplier(double distance, double hTx,
+                                              double hRx) {
+  double multiplier = 1;
 
-    // Compute the multipying factor for each interval
-    double deltaF = attenuationMultiplyingFact * prob[i];
+  double linkHeight = getRainHeight(hTx, hRx, distance);
+  double meanRainHeight = getMeanAnnualRainHeight();
 
-    // Add the multiplying factor for each interval
-    multFactor = multFactor + deltaF;
-    i++;
+  if (linkHeight <= (meanRainHeight - 3600)) {
+    NS_LOG_LOGIC("The location is not affected by the wet snow.");
+  } else {
+    NS_LOG_LOGIC("The location is affected by the wet snow.");
+    multiplier = getSnowAttenFactor(meanRainHeight, linkHeight);
   }
 
-  rainHeightProb.close();
-
-  return multFactor;
+  return multiplier;
 }
+
 /**
  * Computes the attenuation from combined rain and wet snow
  * Input:
@@ -178,23 +236,11 @@ double RainSnowAttenuation::getSnowAttenFactor(double meanRainHeight,
 double RainSnowAttenuation::getSnowAttenuation(double distance,
                                                double frequency, double hTx,
                                                double hRx) {
-  double attenSnow = 0;
-
-  double linkHeight = getRainHeight(hTx, hRx, distance);
-  double meanRainHeight = getMeanAnnualRainHeight();
-
   Ptr<RainAttenuation> rainAtten = CreateObject<RainAttenuation>();
   double rainAttenuation = rainAtten->getRainAttenuation(distance, frequency);
 
-  if (linkHeight <= (meanRainHeight - 3600)) {
-    printf("The location is not affected by the wet snow.\n");
-    attenSnow = rainAttenuation;
-  } else {
-    printf("The location it is affected by the wet snow.\n");
-    double attenFactor = getSnowAttenFactor(meanRainHeight, linkHeight);
-    attenSnow = rainAttenuation * attenFactor;
-  }
-  
+  double attenSnow = rainAttenuation * getSnowMultiplier(distance, hTx, hRx);
+
   return attenSnow;
 }
 } // namespace millicar
@@ -22,7 +22,6 @@
 #ifndef RAIN_SNOW_ATTENUATION_H_
 #define RAIN_SNOW_ATTENUATION_H_
 
-#include "ns3/mmwave-vehicular-propagation-loss-model.h"
 #include "ns3/object.h"
 #include "ns3/rain-attenuation.h"
 
@@ -58,6 +57,12 @@ public:
    */
   double getAttenuationMultiplier(double deltaHeight);
 
+  /**
+   * Computes the factor applied to the rain attenuation to account
+   * for wet snow, given the link geometry
+   */
+  double getSnowMultiplier(double distance, double hTx, double hRx);
+
   /**
    * Computes the attenuation from combined rain and wet snow
    */
@@ -0,0 +1,198 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "shadowing-field.h"
+#include <ns3/log.h>
+#include <ns3/assert.h>
+#include <cmath>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("ShadowingField");
+
+static const uint32_t g_latticePerCorDistance = 8; // lattice points per decorrelation distance
+static const int64_t g_tileSize = 32; // lattice points per side of a tile
+
+/**
+ * \param x the value to mix
+ * \returns a well mixed 64 bit value (splitmix64 finalizer)
+ */
+static uint64_t
+MixBits (uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+/**
+ * \param x the numerator
+ * \param y the denominator, positive
+ * \returns the floor of x / y
+ */
+static int64_t
+FloorDiv (int64_t x, int64_t y)
+{
+  int64_t q = x / y;
+  return (x % y < 0) ? q - 1 : q;
+}
+
+ShadowingField::ShadowingField (double corDistance, uint32_t seed)
+  : m_corDistance (corDistance),
+    m_step (corDistance / g_latticePerCorDistance),
+    m_seed (seed)
+{
+  NS_LOG_FUNCTION (this << corDistance << seed);
+  NS_ASSERT_MSG (corDistance > 0, "The decorrelation distance must be positive");
+
+  // A Gaussian kernel with standard deviation d / 2 gives the correlation
+  // exp (-(r / d)^2) once convolved with itself. It is truncated at three
+  // standard deviations.
+  double sigma = g_latticePerCorDistance / 2.0;
+  int32_t halfWidth = std::ceil (3 * sigma);
+  double energy = 0;
+  for (int32_t k = -halfWidth; k <= halfWidth; ++k)
+    {
+      double w = std::exp (-0.5 * k * k / (sigma * sigma));
+      m_kernel.push_back (w);
+      energy += w * w;
+    }
+  for (double &w : m_kernel)
+    {
+      w /= std::sqrt (energy);
+    }
+}
+
+double
+ShadowingField::GetCorrelationDistance (void) const
+{
+  return m_corDistance;
+}
+
+double
+ShadowingField::GetNoise (int64_t ix, int64_t iy) const
+{
+  uint64_t h = MixBits (MixBits (m_seed ^ static_cast<uint64_t> (ix)) ^ static_cast<uint64_t> (iy));
+  uint64_t h2 = MixBits (h);
+
+  // Box-Muller transform of two uniform values in (0, 1]
+  double u1 = ((h >> 11) + 1) * (1.0 / 9007199254740992.0);
+  double u2 = (h2 >> 11) * (1.0 / 9007199254740992.0);
+  return std::sqrt (-2 * std::log (u1)) * std::cos (2 * M_PI * u2);
+}
+
+void
+ShadowingField::BuildTile (int64_t tx, int64_t ty, std::vector<double> &tile) const
+{
+  NS_LOG_FUNCTION (this << tx << ty);
+
+  int64_t halfWidth = m_kernel.size () / 2;
+  int64_t side = g_tileSize + 2 * halfWidth;
+  int64_t x0 = tx * g_tileSize - halfWidth;
+  int64_t y0 = ty * g_tileSize - halfWidth;
+
+  // filter the rows of the noise, then the columns of the result
+  std::vector<double> rows (g_tileSize * side);
+  std::vector<double> noise (side);
+  for (int64_t j = 0; j < side; ++j)
+    {
+      for (int64_t i = 0; i < side; ++i)
+        {
+          noise[i] = GetNoise (x0 + i, y0 + j);
+        }
+      for (int64_t i = 0; i < g_tileSize; ++i)
+        {
+          double sum = 0;
+          for (size_t k = 0; k < m_kernel.size (); ++k)
+            {
+              sum += m_kernel[k] * noise[i + k];
+            }
+          rows[j * g_tileSize + i] = sum;
+        }
+    }
+
+  tile.assign (g_tileSize * g_tileSize, 0.0);
+  for (int64_t j = 0; j < g_tileSize; ++j)
+    {
+      for (size_t k = 0; k < m_kernel.size (); ++k)
+        {
+          const double *row = &rows[(j + k) * g_tileSize];
+          for (int64_t i = 0; i < g_tileSize; ++i)
+            {
+              tile[j * g_tileSize + i] += m_kernel[k] * row[i];
+            }
+        }
+    }
+}
+
+double
+ShadowingField::GetLatticeValue (int64_t ix, int64_t iy)
+{
+  int64_t tx = FloorDiv (ix, g_tileSize);
+  int64_t ty = FloorDiv (iy, g_tileSize);
+  uint64_t key = (static_cast<uint64_t> (static_cast<uint32_t> (tx)) << 32) | static_cast<uint32_t> (ty);
+
+  std::unordered_map<uint64_t, std::vector<double> >::iterator it = m_tiles.find (key);
+  if (it == m_tiles.end ())
+    {
+      it = m_tiles.insert (std::make_pair (key, std::vector<double> ())).first;
+      BuildTile (tx, ty, it->second);
+    }
+  return it->second[(iy - ty * g_tileSize) * g_tileSize + (ix - tx * g_tileSize)];
+}
+
+double
+ShadowingField::GetValue (double x, double y)
+{
+  double u = x / m_step;
+  double v = y / m_step;
+  int64_t ix = std::floor (u);
+  int64_t iy = std::floor (v);
+  double fx = u - ix;
+  double fy = v - iy;
+
+  return (1 - fx) * (1 - fy) * GetLatticeValue (ix, iy)
+         + fx * (1 - fy) * GetLatticeValue (ix + 1, iy)
+         + (1 - fx) * fy * GetLatticeValue (ix, iy + 1)
+         + fx * fy * GetLatticeValue (ix + 1, iy + 1);
+}
+
+double
+ShadowingField::GetLinkValue (const Vector &a, const Vector &b)
+{
+  double dx = a.x - b.x;
+  double dy = a.y - b.y;
+  double rho = std::exp (-(dx * dx + dy * dy) / (m_corDistance * m_corDistance));
+
+  // the sum of two correlated unit-variance values has variance 2 (1 + rho)
+  return (GetValue (a.x, a.y) + GetValue (b.x, b.y)) / std::sqrt (2 * (1 + rho));
+}
+
+uint32_t
+ShadowingField::GetNumTiles (void) const
+{
+  return m_tiles.size ();
+}
+
+} // namespace millicar
+
+} // namespace ns3
@@ -0,0 +1,118 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef SHADOWING_FIELD_H_
+#define SHADOWING_FIELD_H_
+
+#include <ns3/simple-ref-count.h>
+#include <ns3/vector.h>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * Spatially consistent shadowing shared by all the links of a
+ * MmWaveVehicularPropagationLossModel.
+ *
+ * The field is a zero-mean, unit-variance 2-D Gaussian random field over
+ * the xy plane, with correlation exp (-(r / d)^2), where d is the
+ * decorrelation distance. It is obtained by filtering white Gaussian noise,
+ * defined on a lattice with a step of d / 8, with a separable Gaussian
+ * kernel. The noise of each lattice point is a hash of its indices and of
+ * the seed, therefore the field is built lazily, in square tiles, only
+ * where the vehicles are, and the tiles are cached. A value of the field is
+ * obtained by bilinear interpolation of the lattice.
+ *
+ * The shadowing of a link combines the values of the field at the positions
+ * of the two devices, so that it is reciprocal and the links of the same
+ * vehicle are correlated.
+ */
+class ShadowingField : public SimpleRefCount<ShadowingField>
+{
+public:
+  /**
+   * \param corDistance the decorrelation distance (m)
+   * \param seed the seed of the noise
+   */
+  ShadowingField (double corDistance, uint32_t seed);
+
+  /**
+   * \returns the decorrelation distance (m)
+   */
+  double GetCorrelationDistance (void) const;
+
+  /**
+   * \param x the x coordinate (m)
+   * \param y the y coordinate (m)
+   * \returns the value of the field, with unit variance
+   */
+  double GetValue (double x, double y);
+
+  /**
+   * \param a the position of the first device
+   * \param b the position of the second device
+   * \returns the normalized shadowing of the link, with unit variance
+   */
+  double GetLinkValue (const Vector &a, const Vector &b);
+
+  /**
+   * \returns the number of cached tiles
+   */
+  uint32_t GetNumTiles (void) const;
+
+private:
+  /**
+   * \param ix the x index of the lattice point
+   * \param iy the y index of the lattice point
+   * \returns the white Gaussian noise of the lattice point
+   */
+  double GetNoise (int64_t ix, int64_t iy) const;
+
+  /**
+   * \param ix the x index of the lattice point
+   * \param iy the y index of the lattice point
+   * \returns the filtered field at the lattice point
+   */
+  double GetLatticeValue (int64_t ix, int64_t iy);
+
+  /**
+   * Filter the noise over a tile
+   *
+   * \param tx the x index of the tile
+   * \param ty the y index of the tile
+   * \param tile the vector to fill with the field of the tile
+   */
+  void BuildTile (int64_t tx, int64_t ty, std::vector<double> &tile) const;
+
+  double m_corDistance; //!< the decorrelation distance (m)
+  double m_step; //!< the step of the lattice (m)
+  uint32_t m_seed; //!< the seed of the noise
+  std::vector<double> m_kernel; //!< the 1-D filter, with unit energy
+  std::unordered_map<uint64_t, std::vector<double> > m_tiles; //!< the cached tiles
+};
+
+} // namespace millicar
+
+} // namespace ns3
+
+#endif
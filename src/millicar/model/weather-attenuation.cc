@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "weather-attenuation.h"
+#include <ns3/log.h>
+#include <ns3/double.h>
+#include <cmath>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("WeatherAttenuation");
+
+NS_OBJECT_ENSURE_REGISTERED (WeatherAttenuation);
+
+TypeId
+WeatherAttenuation::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::WeatherAttenuation")
+    .SetParent<Object> ()
+    .AddConstructor<WeatherAttenuation> ()
+    .AddAttribute ("DistanceResolution",
+                   "Distance step (m) of the precomputed rain attenuation table.",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&WeatherAttenuation::m_resolution),
+                   MakeDoubleChecker<double> (1e-3))
+    .AddAttribute ("MaxDistance",
+                   "Largest distance (m) covered by the precomputed rain attenuation table, "
+                   "longer links are evaluated with the analytic model.",
+                   DoubleValue (2000.0),
+                   MakeDoubleAccessor (&WeatherAttenuation::m_maxDistance),
+                   MakeDoubleChecker<double> (0.0))
+  ;
+  return tid;
+}
+
+WeatherAttenuation::WeatherAttenuation ()
+  : m_frequency (0.0),
+    m_tableValid (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+WeatherAttenuation::~WeatherAttenuation ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+WeatherAttenuation::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_rainAtten = nullptr;
+  m_snowAtten = nullptr;
+  m_rainTable.clear ();
+  m_tableValid = false;
+  Object::DoDispose ();
+}
+
+void
+WeatherAttenuation::SetFrequency (double freq)
+{
+  NS_LOG_FUNCTION (this << freq);
+  if (freq != m_frequency)
+    {
+      m_frequency = freq;
+      m_tableValid = false;
+    }
+}
+
+double
+WeatherAttenuation::GetFrequency (void) const
+{
+  return m_frequency;
+}
+
+void
+WeatherAttenuation::BuildTable (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_frequency != 0.0, "Set the operating frequency first!");
+
+  if (!m_rainAtten)
+    {
+      m_rainAtten = CreateObject<RainAttenuation> ();
+      m_snowAtten = CreateObject<RainSnowAttenuation> ();
+    }
+
+  uint32_t numPoints = static_cast<uint32_t> (std::ceil (m_maxDistance / m_resolution)) + 1;
+  m_rainTable.resize (numPoints);
+  for (uint32_t i = 0; i < numPoints; i++)
+    {
+      m_rainTable[i] = m_rainAtten->getRainAttenuation (i * m_resolution, m_frequency);
+    }
+  m_tableValid = true;
+
+  NS_LOG_DEBUG ("Rain attenuation table with " << numPoints << " points, step "
+                << m_resolution << " m, f=" << m_frequency << " Hz");
+}
+
+double
+WeatherAttenuation::GetRainAttenuation (double distance)
+{
+  if (!m_tableValid)
+    {
+      BuildTable ();
+    }
+
+  double pos = distance / m_resolution;
+  if (pos < 0 || pos >= m_rainTable.size () - 1)
+    {
+      return m_rainAtten->getRainAttenuation (distance, m_frequency);
+    }
+
+  uint32_t idx = static_cast<uint32_t> (pos);
+  double frac = pos - idx;
+  return m_rainTable[idx] + frac * (m_rainTable[idx + 1] - m_rainTable[idx]);
+}
+
+double
+WeatherAttenuation::GetSnowAttenuation (double distance, double hTx, double hRx)
+{
+  double rainAtten = GetRainAttenuation (distance);
+  return rainAtten * m_snowAtten->getSnowMultiplier (distance, hTx, hRx);
+}
+
+} // namespace millicar
+
+} // namespace ns3
@@ -0,0 +1,99 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef WEATHER_ATTENUATION_H_
+#define WEATHER_ATTENUATION_H_
+
+#include "ns3/object.h"
+#include "ns3/rain-attenuation.h"
+#include "ns3/rain-snow-attenuation.h"
+#include <vector>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * Weather attenuation engine used by MmWaveVehicularPropagationLossModel.
+ *
+ * The RainAttenuation and RainSnowAttenuation models are instantiated only
+ * once, the first time the attenuation is requested, so that the values set
+ * through Config::SetDefault before the simulation starts are taken into
+ * account. The rain attenuation (ITU-R P.838-3 / P.530-17) depends only on
+ * the distance once the carrier frequency and the rain parameters are fixed,
+ * therefore it is tabulated over [0, MaxDistance] with a step of
+ * DistanceResolution meters and evaluated by linear interpolation.
+ * Distances outside the table are computed with the analytic model.
+ */
+class WeatherAttenuation : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+  WeatherAttenuation ();
+  virtual ~WeatherAttenuation ();
+
+  /**
+   * \param freq the operating frequency (Hz)
+   *
+   * Changing the frequency invalidates the precomputed table.
+   */
+  void SetFrequency (double freq);
+
+  /**
+   * \returns the current frequency (Hz)
+   */
+  double GetFrequency (void) const;
+
+  /**
+   * \param distance the distance between tx and rx in meters
+   * \returns the rain attenuation in dB
+   */
+  double GetRainAttenuation (double distance);
+
+  /**
+   * \param distance the distance between tx and rx in meters
+   * \param hTx the height of the transmitter
+   * \param hRx the height of the receiver
+   * \returns the combined rain and wet snow attenuation in dB
+   */
+  double GetSnowAttenuation (double distance, double hTx, double hRx);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * Create the rain models, if needed, and fill the distance-indexed table
+   */
+  void BuildTable (void);
+
+  double m_frequency; //!< the carrier frequency (Hz)
+  double m_resolution; //!< the distance step of the table (m)
+  double m_maxDistance; //!< the largest tabulated distance (m)
+  bool m_tableValid; //!< true if m_rainTable matches the current configuration
+  std::vector<double> m_rainTable; //!< rain attenuation (dB) at i * m_resolution
+  Ptr<RainAttenuation> m_rainAtten; //!< the rain attenuation model
+  Ptr<RainSnowAttenuation> m_snowAtten; //!< the wet snow attenuation model
+};
+
+} // namespace millicar
+
+} // namespace ns3
+
+#endif
@@ -0,0 +1,259 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/link-state-store.h"
+#include "ns3/log.h"
+#include "ns3/test.h"
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("LinkStateStoreTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * This is a test to check that the links stored in LinkStateStore are found
+ * with their state after the table grows, and that Remove, RemoveNode and
+ * RemoveIdle remove exactly the expected links.
+ */
+class LinkStateStoreTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  LinkStateStoreTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~LinkStateStoreTestCase ();
+
+private:
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Check the state of a stored link
+   * \param store the link store
+   * \param idA the id of the first node
+   * \param idB the id of the second node
+   */
+  void CheckLink (const LinkStateStore &store, uint32_t idA, uint32_t idB);
+
+  /**
+   * \param idA the id of the first node
+   * \param idB the id of the second node
+   * \returns the channel condition stored for the link
+   */
+  static char GetCondition (uint32_t idA, uint32_t idB);
+
+  /**
+   * \param idA the id of the first node
+   * \param idB the id of the second node
+   * \returns the shadowing stored for the link
+   */
+  static double GetShadowing (uint32_t idA, uint32_t idB);
+};
+
+LinkStateStoreTestCase::LinkStateStoreTestCase ()
+  : TestCase ("Link state store")
+{
+}
+
+LinkStateStoreTestCase::~LinkStateStoreTestCase ()
+{
+}
+
+char
+LinkStateStoreTestCase::GetCondition (uint32_t idA, uint32_t idB)
+{
+  const char conditions[] = {'l', 'n', 'v'};
+  return conditions[(idA + idB) % 3];
+}
+
+double
+LinkStateStoreTestCase::GetShadowing (uint32_t idA, uint32_t idB)
+{
+  return std::min (idA, idB) * 1000.0 + std::max (idA, idB);
+}
+
+void
+LinkStateStoreTestCase::CheckLink (const LinkStateStore &store, uint32_t idA, uint32_t idB)
+{
+  uint32_t slot = store.Find (LinkStateStore::GetKey (idA, idB));
+  NS_TEST_ASSERT_MSG_NE (slot, LinkStateStore::INVALID_SLOT, "Link " << idA << "-" << idB << " not found");
+  NS_TEST_ASSERT_MSG_EQ (store.GetCondition (slot), GetCondition (idA, idB), "Wrong condition of link " << idA << "-" << idB);
+  NS_TEST_ASSERT_MSG_EQ (store.GetShadowing (slot), GetShadowing (idA, idB), "Wrong shadowing of link " << idA << "-" << idB);
+  NS_TEST_ASSERT_MSG_EQ (store.GetPosition (slot).x, idA + idB, "Wrong position of link " << idA << "-" << idB);
+}
+
+void
+LinkStateStoreTestCase::DoRun (void)
+{
+  LinkStateStore store;
+  NS_TEST_ASSERT_MSG_EQ (store.Find (LinkStateStore::GetKey (0, 1)), LinkStateStore::INVALID_SLOT, "The empty store finds a link");
+  NS_TEST_ASSERT_MSG_EQ (LinkStateStore::GetKey (3, 7), LinkStateStore::GetKey (7, 3), "The key depends on the order of the nodes");
+  NS_TEST_ASSERT_MSG_NE (LinkStateStore::GetKey (3, 7), LinkStateStore::GetKey (3, 8), "Different links have the same key");
+
+  // all the links among 40 nodes, i.e., 780 links, which grow the table
+  // from 64 slots through several rehashes; the links of even nodes are
+  // last used at 1 s, the others at 2 s
+  const uint32_t numNodes = 40;
+  for (uint32_t a = 0; a < numNodes; a++)
+    {
+      for (uint32_t b = a + 1; b < numNodes; b++)
+        {
+          // insert half of the links in the reverse order
+          uint32_t idA = (a + b) % 2 ? b : a;
+          uint32_t idB = (a + b) % 2 ? a : b;
+          uint32_t slot = store.Insert (LinkStateStore::GetKey (idA, idB), GetCondition (a, b), -1e6, Seconds (0));
+          store.Update (slot, GetShadowing (a, b), Vector (a + b, 0, 0), Seconds (a % 2 ? 2 : 1));
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), numNodes * (numNodes - 1) / 2, "Wrong number of links");
+  for (uint32_t a = 0; a < numNodes; a++)
+    {
+      for (uint32_t b = a + 1; b < numNodes; b++)
+        {
+          CheckLink (store, b, a);
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (store.Find (LinkStateStore::GetKey (0, numNodes)), LinkStateStore::INVALID_SLOT, "Unknown link found");
+
+  // the slots of removed links are reused: the only removed slot is on the
+  // probe sequence of the removed link, hence it is taken again when the
+  // link is inserted, and the other links are preserved
+  NS_TEST_ASSERT_MSG_EQ (store.Remove (LinkStateStore::GetKey (0, numNodes)), false, "Unknown link removed");
+  for (uint32_t round = 0; round < 100; round++)
+    {
+      uint32_t a = round % numNodes;
+      uint32_t b = (round * 7 + 1) % numNodes;
+      if (a == b)
+        {
+          continue;
+        }
+      uint32_t oldSlot = store.Find (LinkStateStore::GetKey (a, b));
+      NS_TEST_ASSERT_MSG_EQ (store.Remove (LinkStateStore::GetKey (a, b)), true, "Link " << a << "-" << b << " not removed");
+      NS_TEST_ASSERT_MSG_EQ (store.Find (LinkStateStore::GetKey (a, b)), LinkStateStore::INVALID_SLOT, "Removed link found");
+      NS_TEST_ASSERT_MSG_EQ (store.Remove (LinkStateStore::GetKey (a, b)), false, "Link removed twice");
+      uint32_t slot = store.Insert (LinkStateStore::GetKey (a, b), GetCondition (a, b), -1e6, Seconds (0));
+      store.Update (slot, GetShadowing (a, b), Vector (a + b, 0, 0), Seconds (std::min (a, b) % 2 ? 2 : 1));
+      NS_TEST_ASSERT_MSG_EQ (slot, oldSlot, "The slot of the removed link is not reused");
+    }
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), numNodes * (numNodes - 1) / 2, "Wrong number of links after reinsertion");
+  for (uint32_t a = 0; a < numNodes; a++)
+    {
+      for (uint32_t b = a + 1; b < numNodes; b++)
+        {
+          CheckLink (store, a, b);
+        }
+    }
+
+  // RemoveNode removes the links of the node, wherever it is in the key
+  uint32_t removedNode = 17;
+  NS_TEST_ASSERT_MSG_EQ (store.RemoveNode (removedNode), numNodes - 1, "Wrong number of links of the removed node");
+  NS_TEST_ASSERT_MSG_EQ (store.RemoveNode (removedNode), 0, "Links of the removed node left");
+  NS_TEST_ASSERT_MSG_EQ (store.RemoveNode (numNodes), 0, "Links of an unknown node removed");
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), (numNodes - 1) * (numNodes - 2) / 2, "Wrong number of links after RemoveNode");
+  for (uint32_t a = 0; a < numNodes; a++)
+    {
+      for (uint32_t b = a + 1; b < numNodes; b++)
+        {
+          if (a == removedNode || b == removedNode)
+            {
+              NS_TEST_ASSERT_MSG_EQ (store.Find (LinkStateStore::GetKey (a, b)), LinkStateStore::INVALID_SLOT,
+                                     "Link " << a << "-" << b << " of the removed node found");
+            }
+          else
+            {
+              CheckLink (store, a, b);
+            }
+        }
+    }
+
+  // RemoveIdle removes the links last used before now - timeout; the
+  // propagation loss model does not sweep the links with a timeout of 0, but
+  // the store then removes all the links which have not been used at the
+  // current time
+  uint32_t size = store.GetSize ();
+  NS_TEST_ASSERT_MSG_EQ (store.RemoveIdle (Seconds (1)), 0, "Links used at 1 s removed with limit 1 s");
+  uint32_t expected = 0;
+  for (uint32_t a = 0; a < numNodes; a++)
+    {
+      for (uint32_t b = a + 1; b < numNodes; b++)
+        {
+          if (a != removedNode && b != removedNode && a % 2 == 0)
+            {
+              expected++;
+            }
+        }
+    }
+  Time now = Seconds (2.5);
+  NS_TEST_ASSERT_MSG_EQ (store.RemoveIdle (now - Seconds (1)), expected, "Wrong number of idle links with timeout 1 s");
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), size - expected, "Wrong number of links after RemoveIdle");
+  for (uint32_t a = 0; a < numNodes; a++)
+    {
+      for (uint32_t b = a + 1; b < numNodes; b++)
+        {
+          if (a == removedNode || b == removedNode || a % 2 == 0)
+            {
+              NS_TEST_ASSERT_MSG_EQ (store.Find (LinkStateStore::GetKey (a, b)), LinkStateStore::INVALID_SLOT,
+                                     "Idle link " << a << "-" << b << " found");
+            }
+          else
+            {
+              CheckLink (store, a, b);
+            }
+        }
+    }
+
+  // a link touched at the current time survives a timeout of 0
+  uint32_t slot = store.Find (LinkStateStore::GetKey (1, 2));
+  store.Touch (slot, now);
+  size = store.GetSize ();
+  NS_TEST_ASSERT_MSG_EQ (store.RemoveIdle (now - Seconds (0)), size - 1, "Wrong number of idle links with timeout 0");
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), 1, "Only the touched link must be left");
+  CheckLink (store, 1, 2);
+
+  // the store is usable after being emptied
+  store.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), 0, "The store is not empty");
+  NS_TEST_ASSERT_MSG_EQ (store.Find (LinkStateStore::GetKey (1, 2)), LinkStateStore::INVALID_SLOT, "Link found after Clear");
+  slot = store.Insert (LinkStateStore::GetKey (1, 2), GetCondition (1, 2), GetShadowing (1, 2), Seconds (0));
+  NS_TEST_ASSERT_MSG_EQ (store.Find (LinkStateStore::GetKey (2, 1)), slot, "Link not found after Clear");
+}
+
+/**
+ * Test suite for LinkStateStore
+ */
+class LinkStateStoreTestSuite : public TestSuite
+{
+public:
+  LinkStateStoreTestSuite ();
+};
+
+LinkStateStoreTestSuite::LinkStateStoreTestSuite ()
+  : TestSuite ("link-state-store", UNIT)
+{
+  AddTestCase (new LinkStateStoreTestCase (), TestCase::QUICK);
+}
+
+static LinkStateStoreTestSuite linkStateStoreTestSuite;
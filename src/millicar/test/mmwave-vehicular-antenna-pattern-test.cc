@@ -0,0 +1,283 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-antenna-array-model.h"
+#include "ns3/log.h"
+#include "ns3/boolean.h"
+#include "ns3/string.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/node.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/test.h"
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularAntennaPatternTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * This is a test to check that the radiation pattern interpolated from the
+ * lookup table of MmWaveVehicularAntennaArrayModel matches the analytic
+ * element pattern of the 3GPP reports.
+ */
+class MmWaveVehicularAntennaPatternTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param pattern the antenna element pattern
+   * \param isUe the device type
+   * \param hpbw the expected half power beamwidth, in degrees
+   * \param gMax the expected max directional gain, in dBi
+   * \param slaMax the expected side-lobe level and front-back ratio, in dB
+   */
+  MmWaveVehicularAntennaPatternTestCase (std::string pattern, bool isUe, double hpbw, double gMax, double slaMax);
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularAntennaPatternTestCase ();
+
+private:
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * \param vAngle the vertical angle, in degrees
+   * \param hAngle the horizontal angle, in degrees
+   * \returns the element gain, in dB, computed with the formulas of TR 38.901 Table 7.3-1
+   */
+  double GetReferenceGainDb (double vAngle, double hAngle) const;
+
+  std::string m_pattern; //!< the antenna element pattern
+  bool m_isUe; //!< the device type
+  double m_hpbw; //!< the expected half power beamwidth, in degrees
+  double m_gMax; //!< the expected max directional gain, in dBi
+  double m_slaMax; //!< the expected side-lobe level and front-back ratio, in dB
+};
+
+MmWaveVehicularAntennaPatternTestCase::MmWaveVehicularAntennaPatternTestCase (std::string pattern, bool isUe, double hpbw, double gMax, double slaMax)
+  : TestCase ("Radiation pattern " + pattern + (isUe ? " UE" : " non-UE")),
+    m_pattern (pattern),
+    m_isUe (isUe),
+    m_hpbw (hpbw),
+    m_gMax (gMax),
+    m_slaMax (slaMax)
+{
+}
+
+MmWaveVehicularAntennaPatternTestCase::~MmWaveVehicularAntennaPatternTestCase ()
+{
+}
+
+double
+MmWaveVehicularAntennaPatternTestCase::GetReferenceGainDb (double vAngle, double hAngle) const
+{
+  double vAttenuation = std::min (m_slaMax, 12 * (vAngle - 90) * (vAngle - 90) / (m_hpbw * m_hpbw));
+  double hAttenuation = std::min (m_slaMax, 12 * hAngle * hAngle / (m_hpbw * m_hpbw));
+  return m_gMax - std::min (m_slaMax, vAttenuation + hAttenuation);
+}
+
+void
+MmWaveVehicularAntennaPatternTestCase::DoRun (void)
+{
+  Ptr<MmWaveVehicularAntennaArrayModel> antenna = CreateObject<MmWaveVehicularAntennaArrayModel> ();
+  antenna->SetAttribute ("IsotropicAntennaElements", BooleanValue (false));
+  antenna->SetAttribute ("AntennaElementPattern", StringValue (m_pattern));
+  antenna->SetDeviceType (m_isUe);
+
+  StringValue pattern;
+  antenna->GetAttribute ("AntennaElementPattern", pattern);
+  NS_TEST_ASSERT_MSG_EQ (pattern.Get (), m_pattern, "The antenna element pattern is not preserved");
+
+  // the peak of the pattern is on a node of the table
+  NS_TEST_ASSERT_MSG_EQ_TOL (antenna->GetRadiationPattern (M_PI / 2, 0), std::pow (10, m_gMax / 20), 1e-12,
+                             "Wrong gain at the boresight");
+
+  // compare the table with the analytic formula over a grid which is not
+  // aligned with the one of the table, with angles out of [-180, 180)
+  double maxErrorDb = 0;
+  for (double vAngle = 0.13; vAngle <= 180; vAngle += 0.77)
+    {
+      for (double hAngle = -540.29; hAngle < 540; hAngle += 1.31)
+        {
+          double wrapped = hAngle - 360 * std::floor ((hAngle + 180) / 360);
+          double expected = GetReferenceGainDb (vAngle, wrapped);
+          double gain = antenna->GetRadiationPattern (vAngle * M_PI / 180, hAngle * M_PI / 180);
+          double analytic = antenna->GetRadiationPatternAnalytic (vAngle * M_PI / 180, hAngle * M_PI / 180);
+
+          NS_TEST_ASSERT_MSG_EQ_TOL (20 * std::log10 (analytic), expected, 1e-9,
+                                     "Wrong analytic gain at " << vAngle << " " << hAngle);
+          maxErrorDb = std::max (maxErrorDb, std::abs (20 * std::log10 (gain) - expected));
+        }
+    }
+  NS_LOG_INFO ("Max interpolation error " << maxErrorDb << " dB");
+  NS_TEST_ASSERT_MSG_LT (maxErrorDb, 0.1, "The interpolated pattern is not accurate");
+
+  // isotropic elements bypass the table
+  antenna->SetAttribute ("IsotropicAntennaElements", BooleanValue (true));
+  NS_TEST_ASSERT_MSG_EQ (antenna->GetRadiationPattern (M_PI / 3, 2.0), 1.0, "Isotropic elements must have unit gain");
+}
+
+/**
+ * This is a test to check that the codebook beams of
+ * MmWaveVehicularAntennaArrayModel follow the changes of the codebook
+ * configuration, i.e., the oversampling and the antenna spacing.
+ */
+class MmWaveVehicularAntennaCodebookTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularAntennaCodebookTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularAntennaCodebookTestCase ();
+
+private:
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * \param antenna the antenna array
+   * \returns the beamforming vector of the antenna towards the other device
+   */
+  complexVector_t GetBeam (Ptr<MmWaveVehicularAntennaArrayModel> antenna) const;
+
+  /**
+   * \param oversampling the oversampling of the codebook
+   * \param spacing the horizontal and vertical antenna spacing, in multiples of lambda
+   * \returns the beamforming vector of a new antenna towards the other device
+   */
+  complexVector_t GetReferenceBeam (uint32_t oversampling, double spacing) const;
+
+  Ptr<NetDevice> m_thisDevice; //!< the device of the antenna
+  Ptr<NetDevice> m_otherDevice; //!< the device the beam is steered to
+};
+
+MmWaveVehicularAntennaCodebookTestCase::MmWaveVehicularAntennaCodebookTestCase ()
+  : TestCase ("Codebook configuration changes")
+{
+}
+
+MmWaveVehicularAntennaCodebookTestCase::~MmWaveVehicularAntennaCodebookTestCase ()
+{
+}
+
+complexVector_t
+MmWaveVehicularAntennaCodebookTestCase::GetBeam (Ptr<MmWaveVehicularAntennaArrayModel> antenna) const
+{
+  antenna->SetBeamformingVectorPanelDevices (m_thisDevice, m_otherDevice);
+  return antenna->GetBeamformingVectorPanel (m_otherDevice);
+}
+
+complexVector_t
+MmWaveVehicularAntennaCodebookTestCase::GetReferenceBeam (uint32_t oversampling, double spacing) const
+{
+  Ptr<MmWaveVehicularAntennaArrayModel> antenna = CreateObject<MmWaveVehicularAntennaArrayModel> ();
+  antenna->SetAttribute ("AntennaElements", UintegerValue (16));
+  antenna->SetAttribute ("CodebookOversampling", UintegerValue (oversampling));
+  antenna->SetAttribute ("AntennaHorizontalSpacing", DoubleValue (spacing));
+  antenna->SetAttribute ("AntennaVerticalSpacing", DoubleValue (spacing));
+  return GetBeam (antenna);
+}
+
+void
+MmWaveVehicularAntennaCodebookTestCase::DoRun (void)
+{
+  // the other device is neither on the boresight nor on a codebook direction
+  Ptr<Node> nodes[2] = {CreateObject<Node> (), CreateObject<Node> ()};
+  Vector positions[2] = {Vector (0, 0, 1.5), Vector (37.3, 11.9, 4.2)};
+  Ptr<NetDevice> devices[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<ConstantPositionMobilityModel> mob = CreateObject<ConstantPositionMobilityModel> ();
+      mob->SetPosition (positions[i]);
+      nodes[i]->AggregateObject (mob);
+      devices[i] = CreateObject<SimpleNetDevice> ();
+      nodes[i]->AddDevice (devices[i]);
+    }
+  m_thisDevice = devices[0];
+  m_otherDevice = devices[1];
+
+  Ptr<MmWaveVehicularAntennaArrayModel> antenna = CreateObject<MmWaveVehicularAntennaArrayModel> ();
+  antenna->SetAttribute ("AntennaElements", UintegerValue (16));
+
+  // every configuration is checked against a new antenna, whose codebook has
+  // never been looked up; 0 steers the beam exactly
+  uint32_t oversamplings[] = {4, 16, 1, 0, 4};
+  for (uint32_t oversampling : oversamplings)
+    {
+      antenna->SetAttribute ("CodebookOversampling", UintegerValue (oversampling));
+      complexVector_t beam = GetBeam (antenna);
+      complexVector_t reference = GetReferenceBeam (oversampling, 0.5);
+      NS_TEST_ASSERT_MSG_EQ (beam.size (), 16, "Wrong beam size with oversampling " << oversampling);
+      for (uint32_t i = 0; i < beam.size (); i++)
+        {
+          NS_TEST_ASSERT_MSG_EQ (beam[i], reference[i], "Stale beam with oversampling " << oversampling);
+        }
+    }
+
+  // the spacing is part of the codebook configuration as well
+  antenna->SetAttribute ("AntennaHorizontalSpacing", DoubleValue (0.7));
+  antenna->SetAttribute ("AntennaVerticalSpacing", DoubleValue (0.7));
+  complexVector_t beam = GetBeam (antenna);
+  complexVector_t reference = GetReferenceBeam (4, 0.7);
+  for (uint32_t i = 0; i < beam.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (beam[i], reference[i], "Stale beam after changing the spacing");
+    }
+  NS_TEST_ASSERT_MSG_NE (beam[1], GetReferenceBeam (4, 0.5)[1], "The spacing does not change the beam");
+
+  m_thisDevice = 0;
+  m_otherDevice = 0;
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      nodes[i]->Dispose ();
+    }
+}
+
+/**
+ * Test suite for the radiation pattern and the codebook of MmWaveVehicularAntennaArrayModel
+ */
+class MmWaveVehicularAntennaPatternTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularAntennaPatternTestSuite ();
+};
+
+MmWaveVehicularAntennaPatternTestSuite::MmWaveVehicularAntennaPatternTestSuite ()
+  : TestSuite ("mmwave-vehicular-antenna-pattern", UNIT)
+{
+  AddTestCase (new MmWaveVehicularAntennaPatternTestCase ("3GPP-MmWave", true, 90, 5, 30), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularAntennaPatternTestCase ("3GPP-MmWave", false, 65, 8, 30), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularAntennaPatternTestCase ("3GPP-V2V", true, 90, 5, 25), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularAntennaCodebookTestCase (), TestCase::QUICK);
+}
+
+static MmWaveVehicularAntennaPatternTestSuite mmwaveVehicularAntennaPatternTestSuite;
@@ -0,0 +1,270 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-propagation-loss-model.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/node.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/string.h"
+#include "ns3/log.h"
+#include "ns3/test.h"
+#include <algorithm>
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularPropagationLossTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * This is a test to check that the batch GetLoss of
+ * MmWaveVehicularPropagationLossModel gives the same losses as a GetLoss call
+ * per receiver, when the two models use the same random streams.
+ */
+class MmWaveVehicularBatchLossTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param scenario the scenario of the propagation loss model
+   * \param shadowingField true to use the spatially consistent shadowing field
+   */
+  MmWaveVehicularBatchLossTestCase (std::string scenario, bool shadowingField);
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularBatchLossTestCase ();
+
+private:
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * \returns a propagation loss model with the configuration of the test
+   */
+  Ptr<MmWaveVehicularPropagationLossModel> CreateModel (void) const;
+
+  std::string m_scenario; //!< the scenario of the propagation loss model
+  bool m_shadowingField; //!< true to use the spatially consistent shadowing field
+};
+
+MmWaveVehicularBatchLossTestCase::MmWaveVehicularBatchLossTestCase (std::string scenario, bool shadowingField)
+  : TestCase ("Batch loss " + scenario + (shadowingField ? " shadowing field" : " shadowing process")),
+    m_scenario (scenario),
+    m_shadowingField (shadowingField)
+{
+}
+
+MmWaveVehicularBatchLossTestCase::~MmWaveVehicularBatchLossTestCase ()
+{
+}
+
+Ptr<MmWaveVehicularPropagationLossModel>
+MmWaveVehicularBatchLossTestCase::CreateModel (void) const
+{
+  Ptr<MmWaveVehicularPropagationLossModel> model = CreateObject<MmWaveVehicularPropagationLossModel> ();
+  model->SetAttribute ("Frequency", DoubleValue (28e9));
+  model->SetAttribute ("Scenario", StringValue (m_scenario));
+  model->SetAttribute ("ChannelCondition", StringValue ("a"));
+  model->SetAttribute ("ShadowingField", BooleanValue (m_shadowingField));
+  model->SetAttribute ("Type3Vehicles", DoubleValue (1.5));
+  model->AssignStreams (100);
+  return model;
+}
+
+void
+MmWaveVehicularBatchLossTestCase::DoRun (void)
+{
+  Ptr<MmWaveVehicularPropagationLossModel> scalarModel = CreateModel ();
+  Ptr<MmWaveVehicularPropagationLossModel> batchModel = CreateModel ();
+
+  // one transmitter and receivers at distances which give all the channel
+  // conditions; the antennas are lower than the blockers, so that the NLOSv
+  // links draw the blockage loss
+  const uint32_t numRx = 12;
+  Ptr<MobilityModel> tx = CreateObject<ConstantPositionMobilityModel> ();
+  CreateObject<Node> ()->AggregateObject (tx);
+  std::vector<Ptr<MobilityModel> > rx;
+  for (uint32_t i = 0; i < numRx; i++)
+    {
+      rx.push_back (CreateObject<ConstantPositionMobilityModel> ());
+      CreateObject<Node> ()->AggregateObject (rx.back ());
+    }
+
+  // the vehicles move between the calls, which updates the shadowing of the
+  // existing links
+  std::vector<double> batchLoss (numRx);
+  uint32_t numConditions[3] = {0, 0, 0};
+  for (uint32_t step = 0; step < 10; step++)
+    {
+      tx->SetPosition (Vector (3.0 * step, 0, 1.5));
+      for (uint32_t i = 0; i < numRx; i++)
+        {
+          double distance = 10 + 40.0 * i + 2.0 * step;
+          rx[i]->SetPosition (Vector (distance * std::cos (0.5 * i), distance * std::sin (0.5 * i), 1.4));
+        }
+
+      batchModel->GetLoss (tx, rx, batchLoss.data ());
+      for (uint32_t i = 0; i < numRx; i++)
+        {
+          double scalarLoss = scalarModel->GetLoss (tx, rx[i]);
+          NS_TEST_ASSERT_MSG_EQ (batchLoss[i], scalarLoss, "Different batch and scalar loss at step " << step << " receiver " << i);
+        }
+    }
+
+  for (uint32_t i = 0; i < numRx; i++)
+    {
+      char condition = batchModel->GetChannelCondition (tx, rx[i]);
+      NS_TEST_ASSERT_MSG_EQ (condition, scalarModel->GetChannelCondition (tx, rx[i]), "Different channel condition of receiver " << i);
+      numConditions[condition == 'l' ? 0 : (condition == 'n' ? 1 : 2)]++;
+    }
+  NS_LOG_INFO ("LOS " << numConditions[0] << " NLOS " << numConditions[1] << " NLOSv " << numConditions[2]);
+  NS_TEST_ASSERT_MSG_EQ (numConditions[0] + numConditions[1] + numConditions[2], numRx, "Unknown channel condition");
+}
+
+/**
+ * This is a test to check that the path loss of
+ * MmWaveVehicularPropagationLossModel, which adds the distance term to an
+ * intercept with the frequency term already included, is equal within
+ * rounding to the formulas of TR 37.885 evaluated term by term, as the model
+ * did before the intercept was precomputed.
+ */
+class MmWaveVehicularPathLossFormulaTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param scenario the scenario of the propagation loss model
+   */
+  MmWaveVehicularPathLossFormulaTestCase (std::string scenario);
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularPathLossFormulaTestCase ();
+
+private:
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * \param condition the channel condition
+   * \param distance3D the 3D distance in meters
+   * \param freqGHz the carrier frequency in GHz
+   * \returns the path loss in dB computed term by term
+   */
+  double GetReferenceLoss (char condition, double distance3D, double freqGHz) const;
+
+  std::string m_scenario; //!< the scenario of the propagation loss model
+};
+
+MmWaveVehicularPathLossFormulaTestCase::MmWaveVehicularPathLossFormulaTestCase (std::string scenario)
+  : TestCase ("Path loss formula " + scenario),
+    m_scenario (scenario)
+{
+}
+
+MmWaveVehicularPathLossFormulaTestCase::~MmWaveVehicularPathLossFormulaTestCase ()
+{
+}
+
+double
+MmWaveVehicularPathLossFormulaTestCase::GetReferenceLoss (char condition, double distance3D, double freqGHz) const
+{
+  if (condition == 'n')
+    {
+      return 36.85 + 30 * log10 (distance3D) + 18.9 * log10 (freqGHz);
+    }
+  if (m_scenario == "V2V-Highway" || m_scenario == "Extended-V2V-Highway")
+    {
+      return 32.4 + 20 * log10 (distance3D) + 20 * log10 (freqGHz);
+    }
+  return 38.77 + 16.7 * log10 (distance3D) + 18.2 * log10 (freqGHz);
+}
+
+void
+MmWaveVehicularPathLossFormulaTestCase::DoRun (void)
+{
+  // the losses are around 100 dB, where the spacing of the doubles is about
+  // 1.4e-14 dB: a different order of the additions changes the result by a few
+  // units in the last place, hence the tolerance
+  const double tolerance = 1e-10;
+
+  // the antennas are higher than the blockers, hence the NLOSv links have no
+  // blockage loss and the losses are deterministic without shadowing
+  Ptr<MobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  CreateObject<Node> ()->AggregateObject (a);
+  Ptr<MobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  CreateObject<Node> ()->AggregateObject (b);
+  a->SetPosition (Vector (0, 0, 3.5));
+
+  double maxError = 0;
+  const char conditions[] = {'l', 'n', 'v'};
+  for (char condition : conditions)
+    {
+      for (double freq : {5.9e9, 28e9, 60e9, 73e9})
+        {
+          // a new model for every condition, since the condition of a link is
+          // drawn once
+          Ptr<MmWaveVehicularPropagationLossModel> model = CreateObject<MmWaveVehicularPropagationLossModel> ();
+          model->SetAttribute ("Frequency", DoubleValue (freq));
+          model->SetAttribute ("Scenario", StringValue (m_scenario));
+          model->SetAttribute ("ChannelCondition", StringValue (std::string (1, condition)));
+          model->SetAttribute ("Shadowing", BooleanValue (false));
+          for (double distance = 1.5; distance < 2000; distance *= 1.37)
+            {
+              b->SetPosition (Vector (distance, 0, 3.5));
+              double loss = model->GetLoss (a, b);
+              double expected = GetReferenceLoss (condition, distance, freq / 1e9);
+              NS_TEST_ASSERT_MSG_EQ_TOL (loss, expected, tolerance, m_scenario << " condition " << condition
+                                         << " frequency " << freq << " distance " << distance);
+              maxError = std::max (maxError, std::abs (loss - expected));
+            }
+        }
+    }
+  NS_LOG_INFO (m_scenario << " maximum difference " << maxError << " dB");
+}
+
+/**
+ * Test suite for MmWaveVehicularPropagationLossModel
+ */
+class MmWaveVehicularPropagationLossTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularPropagationLossTestSuite ();
+};
+
+MmWaveVehicularPropagationLossTestSuite::MmWaveVehicularPropagationLossTestSuite ()
+  : TestSuite ("mmwave-vehicular-propagation-loss", UNIT)
+{
+  AddTestCase (new MmWaveVehicularBatchLossTestCase ("V2V-Highway", false), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularBatchLossTestCase ("V2V-Urban", false), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularBatchLossTestCase ("V2V-Urban", true), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularPathLossFormulaTestCase ("V2V-Highway"), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularPathLossFormulaTestCase ("V2V-Urban"), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularPathLossFormulaTestCase ("Extended-V2V-Highway"), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularPathLossFormulaTestCase ("Extended-V2V-Urban"), TestCase::QUICK);
+}
+
+static MmWaveVehicularPropagationLossTestSuite mmwaveVehicularPropagationLossTestSuite;
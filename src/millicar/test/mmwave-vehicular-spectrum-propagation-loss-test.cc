@@ -0,0 +1,172 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "ns3/spectrum-model.h"
+#include "ns3/boolean.h"
+#include "ns3/log.h"
+#include "ns3/test.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularSpectrumPropagationLossTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * This is a test to check that the subband factors cached by
+ * MmWaveVehicularSpectrumPropagationLossModel::UpdateSubbandFactors, whose
+ * delay phasors are obtained by a recurrence across uniformly spaced
+ * subbands, are equal to exp (-j 2 pi f tau) computed directly for every
+ * subband and divided by the oxygen loss, if enabled.
+ */
+class MmWaveVehicularSubbandFactorsTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param uniform true to use uniformly spaced subbands
+   * \param oxygenAbsorption true to enable the oxygen absorption
+   */
+  MmWaveVehicularSubbandFactorsTestCase (bool uniform, bool oxygenAbsorption);
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularSubbandFactorsTestCase ();
+
+private:
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+
+  bool m_uniform; //!< true to use uniformly spaced subbands
+  bool m_oxygenAbsorption; //!< true to enable the oxygen absorption
+};
+
+MmWaveVehicularSubbandFactorsTestCase::MmWaveVehicularSubbandFactorsTestCase (bool uniform, bool oxygenAbsorption)
+  : TestCase (std::string ("Subband factors, ") + (uniform ? "uniform" : "non-uniform") + " subbands, "
+              + (oxygenAbsorption ? "with" : "without") + " oxygen absorption"),
+    m_uniform (uniform),
+    m_oxygenAbsorption (oxygenAbsorption)
+{
+}
+
+MmWaveVehicularSubbandFactorsTestCase::~MmWaveVehicularSubbandFactorsTestCase ()
+{
+}
+
+void
+MmWaveVehicularSubbandFactorsTestCase::DoRun (void)
+{
+  // the phase 2 pi f tau reaches 7.5e5 rad at 60 GHz with a delay of 2 us,
+  // hence even the direct computation is accurate only to about 1e-10 rad;
+  // the recurrence adds the rounding of at most 63 complex products and of
+  // the phase step before the next exact recompute
+  const double tolerance = 1e-9;
+
+  // 1000 subbands around 60 GHz, where the oxygen loss is the highest; the
+  // number of subbands is not a multiple of the recompute period
+  const uint32_t numBands = 1000;
+  const double spacing = 120e3;
+  std::vector<double> fc;
+  for (uint32_t bIndex = 0; bIndex < numBands; bIndex++)
+    {
+      double offset = m_uniform ? 0.0 : 0.3 * spacing * std::sin (0.7 * bIndex);
+      fc.push_back (60e9 - numBands / 2 * spacing + bIndex * spacing + offset);
+    }
+  Ptr<const SpectrumModel> model = Create<SpectrumModel> (fc);
+
+  Ptr<MmWaveVehicularSpectrumPropagationLossModel> lossModel = CreateObject<MmWaveVehicularSpectrumPropagationLossModel> ();
+  lossModel->SetAttribute ("OxygenAbsorption", BooleanValue (m_oxygenAbsorption));
+
+  Ptr<Params3gpp> params = Create<Params3gpp> ();
+  params->m_delay = {0.0, 13e-9, 87e-9, 0.31e-6, 0.72e-6, 1.46e-6, 2e-6};
+  params->m_numCluster = params->m_delay.size ();
+  params->m_tauDelta = 25e-9;
+  params->m_dis3D = 200;
+
+  lossModel->UpdateSubbandFactors (params, model);
+  const SubbandFactors &factors = params->m_subbandFactors;
+  NS_TEST_ASSERT_MSG_EQ (factors.m_real.size (), params->m_numCluster * numBands, "Wrong number of factors");
+
+  double maxError = 0;
+  double minOxygenGain = 1;
+  for (uint8_t cIndex = 0; cIndex < params->m_numCluster; cIndex++)
+    {
+      double tau = params->m_delay[cIndex];
+      double tauDelta = (cIndex != 0) ? params->m_tauDelta : 0.0;
+      for (uint32_t bIndex = 0; bIndex < numBands; bIndex++)
+        {
+          std::complex<double> expected = std::exp (std::complex<double> (0, -2 * M_PI * fc[bIndex] * tau));
+          if (m_oxygenAbsorption)
+            {
+              double oxygenLoss = lossModel->GetOxygenLoss (fc[bIndex], params->m_dis3D, tau, tauDelta);
+              expected /= oxygenLoss;
+              minOxygenGain = std::min (minOxygenGain, 1 / oxygenLoss);
+            }
+          uint32_t index = cIndex * numBands + bIndex;
+          NS_TEST_ASSERT_MSG_EQ_TOL (factors.m_real[index], expected.real (), tolerance,
+                                     "Wrong real part of cluster " << +cIndex << " subband " << bIndex);
+          NS_TEST_ASSERT_MSG_EQ_TOL (factors.m_imag[index], expected.imag (), tolerance,
+                                     "Wrong imaginary part of cluster " << +cIndex << " subband " << bIndex);
+          maxError = std::max (maxError, std::abs (std::complex<double> (factors.m_real[index], factors.m_imag[index]) - expected));
+        }
+    }
+  NS_LOG_INFO (GetName () << ": maximum error " << maxError << ", minimum oxygen gain " << minOxygenGain);
+  if (m_oxygenAbsorption)
+    {
+      NS_TEST_ASSERT_MSG_LT (minOxygenGain, 0.5, "The oxygen loss is not exercised");
+    }
+
+  // the factors are computed again when the oxygen absorption setting changes
+  lossModel->SetAttribute ("OxygenAbsorption", BooleanValue (!m_oxygenAbsorption));
+  lossModel->UpdateSubbandFactors (params, model);
+  double tau = params->m_delay.back ();
+  std::complex<double> expected = std::exp (std::complex<double> (0, -2 * M_PI * fc[0] * tau));
+  if (!m_oxygenAbsorption)
+    {
+      expected /= lossModel->GetOxygenLoss (fc[0], params->m_dis3D, tau, params->m_tauDelta);
+    }
+  uint32_t index = (params->m_numCluster - 1) * numBands;
+  NS_TEST_ASSERT_MSG_EQ_TOL (factors.m_real[index], expected.real (), tolerance, "Factors not updated with the oxygen absorption");
+  NS_TEST_ASSERT_MSG_EQ_TOL (factors.m_imag[index], expected.imag (), tolerance, "Factors not updated with the oxygen absorption");
+}
+
+/**
+ * Test suite for MmWaveVehicularSpectrumPropagationLossModel
+ */
+class MmWaveVehicularSpectrumPropagationLossTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularSpectrumPropagationLossTestSuite ();
+};
+
+MmWaveVehicularSpectrumPropagationLossTestSuite::MmWaveVehicularSpectrumPropagationLossTestSuite ()
+  : TestSuite ("mmwave-vehicular-spectrum-propagation-loss", UNIT)
+{
+  AddTestCase (new MmWaveVehicularSubbandFactorsTestCase (true, false), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularSubbandFactorsTestCase (true, true), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularSubbandFactorsTestCase (false, false), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularSubbandFactorsTestCase (false, true), TestCase::QUICK);
+}
+
+static MmWaveVehicularSpectrumPropagationLossTestSuite mmwaveVehicularSpectrumPropagationLossTestSuite;
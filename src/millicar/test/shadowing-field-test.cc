@@ -0,0 +1,322 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/shadowing-field.h"
+#include "ns3/mmwave-vehicular-propagation-loss-model.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/node.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/string.h"
+#include "ns3/log.h"
+#include "ns3/test.h"
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("ShadowingFieldTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * This is a test to check that the tiles of ShadowingField give the same
+ * values whatever the order of the lookups, and that the field is continuous
+ * across the borders of the tiles.
+ */
+class ShadowingFieldTileTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  ShadowingFieldTileTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~ShadowingFieldTileTestCase ();
+
+private:
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+};
+
+ShadowingFieldTileTestCase::ShadowingFieldTileTestCase ()
+  : TestCase ("Shadowing field tiles")
+{
+}
+
+ShadowingFieldTileTestCase::~ShadowingFieldTileTestCase ()
+{
+}
+
+void
+ShadowingFieldTileTestCase::DoRun (void)
+{
+  double corDistance = 10;
+  Ptr<ShadowingField> field = Create<ShadowingField> (corDistance, 1);
+  NS_TEST_ASSERT_MSG_EQ (field->GetNumTiles (), 0, "The tiles must be built lazily");
+
+  // a grid over four tiles around the origin, which is on a tile corner
+  std::vector<Vector> points;
+  for (double x = -47.3; x < 47.3; x += 3.1)
+    {
+      for (double y = -47.3; y < 47.3; y += 2.9)
+        {
+          points.push_back (Vector (x, y, 0));
+        }
+    }
+  std::vector<double> values;
+  for (const Vector &p : points)
+    {
+      values.push_back (field->GetValue (p.x, p.y));
+    }
+  uint32_t numTiles = field->GetNumTiles ();
+  NS_TEST_ASSERT_MSG_GT (numTiles, 1, "The grid must span several tiles");
+
+  // repeated lookups hit the cache
+  for (uint32_t i = 0; i < points.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (field->GetValue (points[i].x, points[i].y), values[i], "Different value for a repeated lookup");
+    }
+  NS_TEST_ASSERT_MSG_EQ (field->GetNumTiles (), numTiles, "Repeated lookups must not build tiles");
+
+  // a field with the same seed, whose tiles are built in the reverse order,
+  // gives the same values; another seed does not
+  Ptr<ShadowingField> reverse = Create<ShadowingField> (corDistance, 1);
+  Ptr<ShadowingField> other = Create<ShadowingField> (corDistance, 2);
+  uint32_t differences = 0;
+  for (uint32_t i = points.size (); i-- > 0; )
+    {
+      NS_TEST_ASSERT_MSG_EQ (reverse->GetValue (points[i].x, points[i].y), values[i], "The value depends on the order of the lookups");
+      differences += other->GetValue (points[i].x, points[i].y) != values[i];
+    }
+  NS_TEST_ASSERT_MSG_EQ (differences, points.size (), "The field does not depend on the seed");
+
+  // the tiles have 32 lattice points per side, with a step of d / 8, hence
+  // their borders are at multiples of 4 d; the field must be continuous
+  // there, as everywhere else
+  double tileSide = 4 * corDistance;
+  double epsilon = 1e-6;
+  double maxJump = 0;
+  for (int32_t k = -3; k <= 3; k++)
+    {
+      for (double s = -61.7; s < 61.7; s += 0.9)
+        {
+          double border = k * tileSide;
+          maxJump = std::max (maxJump, std::abs (field->GetValue (border - epsilon, s) - field->GetValue (border + epsilon, s)));
+          maxJump = std::max (maxJump, std::abs (field->GetValue (s, border - epsilon) - field->GetValue (s, border + epsilon)));
+        }
+    }
+  NS_LOG_INFO ("Max jump across the tile borders " << maxJump);
+  NS_TEST_ASSERT_MSG_LT (maxJump, 1e-3, "The field is not continuous across the tile borders");
+
+  // the shadowing of a link is reciprocal
+  Vector a (12.3, -4.5, 1.5);
+  Vector b (-30.2, 17.8, 1.6);
+  NS_TEST_ASSERT_MSG_EQ (field->GetLinkValue (a, b), field->GetLinkValue (b, a), "The link value is not reciprocal");
+}
+
+/**
+ * This is a test to check the statistics of ShadowingField: the values and
+ * the link values have zero mean and unit variance, the shadowing of
+ * MmWaveVehicularPropagationLossModel has the standard deviation of the
+ * scenario, and the correlation between two points decays with their
+ * distance as exp (-(r / d)^2).
+ */
+class ShadowingFieldStatisticsTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  ShadowingFieldStatisticsTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~ShadowingFieldStatisticsTestCase ();
+
+private:
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * \param field the shadowing field
+   * \param distance the distance between the two points of each sample
+   * \returns the sample correlation of the field between points at the given distance
+   */
+  double GetCorrelation (Ptr<ShadowingField> field, double distance) const;
+
+  /**
+   * \returns the standard deviation of the shadowing of
+   *          MmWaveVehicularPropagationLossModel over a set of links of the same length
+   */
+  double GetLossStd (void) const;
+
+  static const uint32_t NUM_SAMPLES = 2000; //!< number of samples of every statistic
+};
+
+ShadowingFieldStatisticsTestCase::ShadowingFieldStatisticsTestCase ()
+  : TestCase ("Shadowing field statistics")
+{
+}
+
+ShadowingFieldStatisticsTestCase::~ShadowingFieldStatisticsTestCase ()
+{
+}
+
+double
+ShadowingFieldStatisticsTestCase::GetCorrelation (Ptr<ShadowingField> field, double distance) const
+{
+  // the samples are 3 d apart, hence practically independent
+  double spacing = 3 * field->GetCorrelationDistance ();
+  double sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+  for (uint32_t i = 0; i < NUM_SAMPLES; i++)
+    {
+      double x = (i % 50) * spacing;
+      double y = (i / 50) * spacing;
+      double a = field->GetValue (x, y);
+      // the second point is in a direction which changes with the sample
+      double b = field->GetValue (x + distance * std::cos (i * 0.7), y + distance * std::sin (i * 0.7));
+      sumA += a;
+      sumB += b;
+      sumAA += a * a;
+      sumBB += b * b;
+      sumAB += a * b;
+    }
+  double n = NUM_SAMPLES;
+  double covariance = sumAB / n - sumA * sumB / (n * n);
+  return covariance / std::sqrt ((sumAA / n - sumA * sumA / (n * n)) * (sumBB / n - sumB * sumB / (n * n)));
+}
+
+double
+ShadowingFieldStatisticsTestCase::GetLossStd (void) const
+{
+  // in LOS, the links of the same length have the same loss but for the
+  // shadowing
+  Ptr<MmWaveVehicularPropagationLossModel> model = CreateObject<MmWaveVehicularPropagationLossModel> ();
+  model->SetAttribute ("Frequency", DoubleValue (28e9));
+  model->SetAttribute ("Scenario", StringValue ("V2V-Urban"));
+  model->SetAttribute ("ChannelCondition", StringValue ("l"));
+  model->SetAttribute ("ShadowingField", BooleanValue (true));
+
+  Ptr<MobilityModel> mob[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      mob[i] = CreateObject<ConstantPositionMobilityModel> ();
+      CreateObject<Node> ()->AggregateObject (mob[i]);
+    }
+
+  double spacing = 30;
+  double sum = 0, sumSquares = 0;
+  for (uint32_t i = 0; i < NUM_SAMPLES; i++)
+    {
+      double x = (i % 50) * spacing;
+      double y = (i / 50) * spacing;
+      mob[0]->SetPosition (Vector (x, y, 1.5));
+      mob[1]->SetPosition (Vector (x + 20 * std::cos (i * 0.7), y + 20 * std::sin (i * 0.7), 1.5));
+      double loss = model->GetLoss (mob[0], mob[1]);
+      sum += loss;
+      sumSquares += loss * loss;
+    }
+  double n = NUM_SAMPLES;
+  return std::sqrt (sumSquares / n - sum * sum / (n * n));
+}
+
+void
+ShadowingFieldStatisticsTestCase::DoRun (void)
+{
+  double corDistance = 10;
+  Ptr<ShadowingField> field = Create<ShadowingField> (corDistance, 7);
+
+  // the field and the link values have unit variance, the samples are 3 d
+  // apart; with 2000 samples, the standard error of the variance is 0.03
+  double spacing = 3 * corDistance;
+  double sum = 0, sumSquares = 0;
+  double linkSum[2] = {0, 0};
+  double linkSumSquares[2] = {0, 0};
+  double linkDistances[2] = {0.5 * corDistance, 5 * corDistance};
+  for (uint32_t i = 0; i < NUM_SAMPLES; i++)
+    {
+      double x = (i % 50) * spacing + 0.37;
+      double y = (i / 50) * spacing + 0.81;
+      double value = field->GetValue (x, y);
+      sum += value;
+      sumSquares += value * value;
+      for (uint32_t j = 0; j < 2; j++)
+        {
+          Vector a (x, y, 1.5);
+          Vector b (x + linkDistances[j] * std::cos (i * 0.7), y + linkDistances[j] * std::sin (i * 0.7), 1.5);
+          double linkValue = field->GetLinkValue (a, b);
+          linkSum[j] += linkValue;
+          linkSumSquares[j] += linkValue * linkValue;
+        }
+    }
+  double n = NUM_SAMPLES;
+  NS_LOG_INFO ("Field mean " << sum / n << " variance " << sumSquares / n - sum * sum / (n * n));
+  NS_TEST_ASSERT_MSG_EQ_TOL (sum / n, 0, 0.1, "The field does not have zero mean");
+  NS_TEST_ASSERT_MSG_EQ_TOL (sumSquares / n - sum * sum / (n * n), 1, 0.15, "The field does not have unit variance");
+  for (uint32_t j = 0; j < 2; j++)
+    {
+      double variance = linkSumSquares[j] / n - linkSum[j] * linkSum[j] / (n * n);
+      NS_LOG_INFO ("Link value at " << linkDistances[j] << " m mean " << linkSum[j] / n << " variance " << variance);
+      NS_TEST_ASSERT_MSG_EQ_TOL (linkSum[j] / n, 0, 0.1, "The link value does not have zero mean");
+      NS_TEST_ASSERT_MSG_EQ_TOL (variance, 1, 0.15, "The link value does not have unit variance, link of " << linkDistances[j] << " m");
+    }
+
+  // the model scales the link values by the standard deviation of the
+  // scenario, 3 dB in LOS
+  double lossStd = GetLossStd ();
+  NS_LOG_INFO ("Standard deviation of the shadowing " << lossStd << " dB");
+  NS_TEST_ASSERT_MSG_EQ_TOL (lossStd, 3.0, 0.25, "The shadowing does not have the standard deviation of the scenario");
+
+  // the points closer than the decorrelation distance are correlated, the
+  // distant ones are not; the standard error of the correlation is below 0.03
+  double distances[] = {0.1, 0.3, 0.5, 1, 2, 4};
+  for (double distance : distances)
+    {
+      double correlation = GetCorrelation (field, distance * corDistance);
+      double expected = std::exp (-distance * distance);
+      NS_LOG_INFO ("Correlation at " << distance << " d: " << correlation << ", expected " << expected);
+      NS_TEST_ASSERT_MSG_EQ_TOL (correlation, expected, 0.1, "Wrong correlation at " << distance << " times the decorrelation distance");
+    }
+  NS_TEST_ASSERT_MSG_GT (GetCorrelation (field, 0.3 * corDistance), 0.8, "Close points are not correlated");
+  NS_TEST_ASSERT_MSG_LT (std::abs (GetCorrelation (field, 4 * corDistance)), 0.1, "Distant points are correlated");
+}
+
+/**
+ * Test suite for ShadowingField
+ */
+class ShadowingFieldTestSuite : public TestSuite
+{
+public:
+  ShadowingFieldTestSuite ();
+};
+
+ShadowingFieldTestSuite::ShadowingFieldTestSuite ()
+  : TestSuite ("shadowing-field", UNIT)
+{
+  AddTestCase (new ShadowingFieldTileTestCase (), TestCase::QUICK);
+  AddTestCase (new ShadowingFieldStatisticsTestCase (), TestCase::QUICK);
+}
+
+static ShadowingFieldTestSuite shadowingFieldTestSuite;
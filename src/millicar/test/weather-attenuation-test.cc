@@ -0,0 +1,188 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2021 Telecommunication Networks (TKN), TU Berlin
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/weather-attenuation.h"
+#include "ns3/rain-attenuation.h"
+#include "ns3/config.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/log.h"
+#include "ns3/test.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+NS_LOG_COMPONENT_DEFINE ("WeatherAttenuationTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * This is a test to check that the rain attenuation interpolated by
+ * WeatherAttenuation from its distance table matches
+ * RainAttenuation::getRainAttenuation at the grid samples, between them and
+ * beyond MaxDistance, where the analytic model is used, and that the table is
+ * rebuilt when the frequency changes.
+ */
+class WeatherAttenuationTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param resolution the distance step of the table in meters
+   */
+  WeatherAttenuationTestCase (double resolution);
+
+  /**
+   * Destructor
+   */
+  virtual ~WeatherAttenuationTestCase ();
+
+private:
+  /**
+   * \param resolution the distance step of the table in meters
+   * \returns the name of the test case
+   */
+  static std::string BuildNameString (double resolution);
+
+  /**
+   * This method run the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Check the interpolated attenuation over the whole table and beyond
+   * \param weather the weather attenuation under test
+   * \param rain the reference rain attenuation model
+   * \param freq the carrier frequency in Hz
+   */
+  void CheckAttenuation (Ptr<WeatherAttenuation> weather, Ptr<RainAttenuation> rain, double freq);
+
+  double m_resolution; //!< the distance step of the table in meters
+  double m_maxDistance; //!< the largest tabulated distance in meters
+};
+
+std::string
+WeatherAttenuationTestCase::BuildNameString (double resolution)
+{
+  std::ostringstream oss;
+  oss << "Rain attenuation table with step " << resolution << " m";
+  return oss.str ();
+}
+
+WeatherAttenuationTestCase::WeatherAttenuationTestCase (double resolution)
+  : TestCase (BuildNameString (resolution)),
+    m_resolution (resolution),
+    m_maxDistance (1000)
+{
+}
+
+WeatherAttenuationTestCase::~WeatherAttenuationTestCase ()
+{
+}
+
+void
+WeatherAttenuationTestCase::CheckAttenuation (Ptr<WeatherAttenuation> weather, Ptr<RainAttenuation> rain, double freq)
+{
+  // the table covers MaxDistance with a whole number of steps
+  uint32_t numSteps = static_cast<uint32_t> (std::ceil (m_maxDistance / m_resolution));
+  double tableEnd = numSteps * m_resolution;
+
+  double maxError = 0;
+  for (uint32_t i = 0; i < numSteps; i++)
+    {
+      // the grid samples are exact
+      double distance = i * m_resolution;
+      NS_TEST_ASSERT_MSG_EQ_TOL (weather->GetRainAttenuation (distance), rain->getRainAttenuation (distance, freq), 1e-12,
+                                 "Wrong attenuation at the grid sample " << distance << " m, f=" << freq);
+
+      // between the samples the value is interpolated linearly; the
+      // attenuation is monotone in the distance, hence the interpolation error
+      // is bounded by the change of the attenuation over the step
+      double lower = rain->getRainAttenuation (distance, freq);
+      double upper = rain->getRainAttenuation (distance + m_resolution, freq);
+      for (double frac : {0.25, 0.5, 0.9})
+        {
+          double d = distance + frac * m_resolution;
+          double atten = weather->GetRainAttenuation (d);
+          double exact = rain->getRainAttenuation (d, freq);
+          maxError = std::max (maxError, std::abs (atten - exact));
+          NS_TEST_ASSERT_MSG_EQ_TOL (atten, lower + frac * (upper - lower), 1e-12,
+                                     "Not a linear interpolation at " << d << " m, f=" << freq);
+          NS_TEST_ASSERT_MSG_EQ_TOL (atten, exact, std::abs (upper - lower),
+                                     "Wrong interpolated attenuation at " << d << " m, f=" << freq);
+        }
+    }
+
+  // MaxDistance is either inside the table or at its end, from the end of the
+  // table on the analytic model is used
+  NS_TEST_ASSERT_MSG_EQ_TOL (weather->GetRainAttenuation (m_maxDistance), rain->getRainAttenuation (m_maxDistance, freq),
+                             rain->getRainAttenuation (tableEnd, freq) - rain->getRainAttenuation (tableEnd - m_resolution, freq),
+                             "Wrong attenuation at MaxDistance, f=" << freq);
+  for (double distance : {tableEnd, tableEnd + 0.3 * m_resolution, 1.7 * m_maxDistance})
+    {
+      NS_TEST_ASSERT_MSG_EQ (weather->GetRainAttenuation (distance), rain->getRainAttenuation (distance, freq),
+                             "Wrong attenuation beyond the table at " << distance << " m, f=" << freq);
+    }
+  NS_LOG_INFO ("f=" << freq << " step " << m_resolution << " m: maximum interpolation error " << maxError << " dB");
+}
+
+void
+WeatherAttenuationTestCase::DoRun (void)
+{
+  // the rain models are created by WeatherAttenuation with the default
+  // attributes, hence the reference model is configured in the same way
+  Config::SetDefault ("ns3::RainAttenuation::RainRate", UintegerValue (50));
+  Config::SetDefault ("ns3::RainAttenuation::k", DoubleValue (0.2));
+  Config::SetDefault ("ns3::RainAttenuation::alpha", DoubleValue (0.95));
+  Ptr<RainAttenuation> rain = CreateObject<RainAttenuation> ();
+
+  Ptr<WeatherAttenuation> weather = CreateObject<WeatherAttenuation> ();
+  weather->SetAttribute ("DistanceResolution", DoubleValue (m_resolution));
+  weather->SetAttribute ("MaxDistance", DoubleValue (m_maxDistance));
+
+  weather->SetFrequency (28e9);
+  NS_TEST_ASSERT_MSG_GT (weather->GetRainAttenuation (500), 0, "The rain attenuation is not exercised");
+  CheckAttenuation (weather, rain, 28e9);
+
+  // a new frequency invalidates the table, which is built again
+  weather->SetFrequency (73e9);
+  NS_TEST_ASSERT_MSG_NE (weather->GetRainAttenuation (500), rain->getRainAttenuation (500, 28e9),
+                         "The table is not rebuilt after a frequency change");
+  CheckAttenuation (weather, rain, 73e9);
+
+  Config::Reset ();
+}
+
+/**
+ * Test suite for WeatherAttenuation
+ */
+class WeatherAttenuationTestSuite : public TestSuite
+{
+public:
+  WeatherAttenuationTestSuite ();
+};
+
+WeatherAttenuationTestSuite::WeatherAttenuationTestSuite ()
+  : TestSuite ("weather-attenuation", UNIT)
+{
+  AddTestCase (new WeatherAttenuationTestCase (1.0), TestCase::QUICK);
+  AddTestCase (new WeatherAttenuationTestCase (7.0), TestCase::QUICK);
+}
+
+static WeatherAttenuationTestSuite weatherAttenuationTestSuite;
@@ -44,8 +44,7 @@ namespace mmwave {
 
 mmWaveInterference::mmWaveInterference ()
   : m_receiving (false),
-    m_lastSignalId (0),
-    m_lastSignalIdBeforeReset (0)
+    m_lastSignalId (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -64,6 +63,11 @@ mmWaveInterference::DoDispose ()
   m_rxSignal = 0;
   m_allSignals = 0;
   m_noise = 0;
+  m_sinr = 0;
+  while (!m_pendingSignals.empty ())
+    {
+      m_pendingSignals.pop ();
+    }
   Object::DoDispose ();
 }
 
@@ -85,7 +89,15 @@ mmWaveInterference::StartRx (Ptr<const SpectrumValue> rxPsd)
   if (m_receiving == false)
     {
       NS_LOG_LOGIC ("first signal");
-      m_rxSignal = rxPsd->Copy ();
+      if (m_rxSignal == 0)
+        {
+          m_rxSignal = rxPsd->Copy ();
+        }
+      else
+        {
+          // reuse the buffer of the previous reception
+          (*m_rxSignal) = (*rxPsd);
+        }
       m_lastChangeTime = Now ();
       m_receiving = true;
       for (std::list<Ptr<mmWaveChunkProcessor> >::const_iterator it = m_PowerChunkProcessorList.begin (); it != m_PowerChunkProcessorList.end (); ++it)
@@ -137,70 +149,73 @@ void
 mmWaveInterference::AddSignal (Ptr<const SpectrumValue> spd, const Time duration)
 {
   NS_LOG_FUNCTION (this << *spd << duration);
-  DoAddSignal (spd);
-  uint32_t signalId = ++m_lastSignalId;
-  if (signalId == m_lastSignalIdBeforeReset)
-    {
-      // This happens when m_lastSignalId eventually wraps around. Given that so
-      // many signals have elapsed since the last reset, we hope that by now there is
-      // no stale pending signal (i.e., a signal that was scheduled
-      // for subtraction before the reset). So we just move the
-      // boundary further.
-      m_lastSignalIdBeforeReset += 0x10000000;
-    }
-  Simulator::Schedule (duration, &mmWaveInterference::DoSubtractSignal, this, spd, signalId);
-}
-
-
-void
-mmWaveInterference::DoAddSignal (Ptr<const SpectrumValue> spd)
-{
-  NS_LOG_FUNCTION (this << *spd);
   ConditionallyEvaluateChunk ();
   (*m_allSignals) += (*spd);
+
+  // the signal is subtracted at the first evaluation after its end, instead
+  // of scheduling an event for it
+  PendingSignal signal;
+  signal.m_endTime = Now () + duration;
+  signal.m_id = ++m_lastSignalId;
+  signal.m_psd = spd;
+  m_pendingSignals.push (signal);
 }
 
 void
-mmWaveInterference::DoSubtractSignal  (Ptr<const SpectrumValue> spd, uint32_t signalId)
+mmWaveInterference::SubtractEndedSignals ()
 {
-  NS_LOG_FUNCTION (this << *spd);
-  ConditionallyEvaluateChunk ();
-  int32_t deltaSignalId = signalId - m_lastSignalIdBeforeReset;
-  if (deltaSignalId > 0)
-    {
-      (*m_allSignals) -= (*spd);
-    }
-  else
+  NS_LOG_FUNCTION (this);
+  while (!m_pendingSignals.empty () && m_pendingSignals.top ().m_endTime <= Now ())
     {
-      NS_LOG_INFO ("ignoring signal scheduled for subtraction before last reset");
+      // the chunk until the end of the signal still includes it
+      const PendingSignal &signal = m_pendingSignals.top ();
+      EvaluateChunk (signal.m_endTime);
+      (*m_allSignals) -= (*signal.m_psd);
+      m_pendingSignals.pop ();
     }
 }
 
-
 void
 mmWaveInterference::ConditionallyEvaluateChunk ()
 {
   NS_LOG_FUNCTION (this);
+  SubtractEndedSignals ();
+  EvaluateChunk (Now ());
+}
+
+void
+mmWaveInterference::EvaluateChunk (Time now)
+{
+  NS_LOG_FUNCTION (this << now);
   if (m_receiving)
     {
       NS_LOG_DEBUG (this << " Receiving");
     }
-  NS_LOG_DEBUG (this << " now "  << Now () << " last " << m_lastChangeTime);
-  if (m_receiving && (Now () > m_lastChangeTime))
+  NS_LOG_DEBUG (this << " now "  << now << " last " << m_lastChangeTime);
+  if (m_receiving && (now > m_lastChangeTime))
     {
       NS_LOG_LOGIC (this << " signal = " << *m_rxSignal << " allSignals = " << *m_allSignals << " noise = " << *m_noise);
-      SpectrumValue interf =  (*m_allSignals) - (*m_rxSignal) + (*m_noise);
-      SpectrumValue sinr = (*m_rxSignal) / interf;
-      Time duration = Now () - m_lastChangeTime;
+      // sinr = signal / (allSignals - signal + noise), computed in place
+      Values::const_iterator signalIt = m_rxSignal->ConstValuesBegin ();
+      Values::const_iterator allSignalsIt = m_allSignals->ConstValuesBegin ();
+      Values::const_iterator noiseIt = m_noise->ConstValuesBegin ();
+      for (Values::iterator sinrIt = m_sinr->ValuesBegin (); sinrIt != m_sinr->ValuesEnd (); ++sinrIt)
+        {
+          *sinrIt = *signalIt / (*allSignalsIt - *signalIt + *noiseIt);
+          ++signalIt;
+          ++allSignalsIt;
+          ++noiseIt;
+        }
+      Time duration = now - m_lastChangeTime;
       for (std::list<Ptr<mmWaveChunkProcessor> >::const_iterator it = m_PowerChunkProcessorList.begin (); it != m_PowerChunkProcessorList.end (); ++it)
         {
           (*it)->EvaluateChunk (*m_rxSignal, duration);
         }
       for (std::list<Ptr<mmWaveChunkProcessor> >::const_iterator it = m_sinrChunkProcessorList.begin (); it != m_sinrChunkProcessorList.end (); ++it)
         {
-          (*it)->EvaluateChunk (sinr, duration);
+          (*it)->EvaluateChunk (*m_sinr, duration);
         }
-      m_lastChangeTime = Now ();
+      m_lastChangeTime = now;
     }
 }
 
@@ -211,12 +226,17 @@ mmWaveInterference::SetNoisePowerSpectralDensity (Ptr<const SpectrumValue> noise
   ConditionallyEvaluateChunk ();
   m_noise = noisePsd;
   m_allSignals = Create<SpectrumValue> (noisePsd->GetSpectrumModel ());
+  m_sinr = Create<SpectrumValue> (noisePsd->GetSpectrumModel ());
   if (m_receiving == true)
     {
       // abort rx
       m_receiving = false;
     }
-  m_lastSignalIdBeforeReset = m_lastSignalId;
+  // the signals received before the reset are not subtracted
+  while (!m_pendingSignals.empty ())
+    {
+      m_pendingSignals.pop ();
+    }
 }
 
 void
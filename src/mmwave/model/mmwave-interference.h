@@ -36,6 +36,8 @@
 #include <ns3/spectrum-value.h>
 #include <string.h>
 #include <ns3/mmwave-chunk-processor.h>
+#include <queue>
+#include <vector>
 
 
 namespace ns3 {
@@ -57,9 +59,22 @@ public:
   void AddSinrChunkProcessor (Ptr<mmWaveChunkProcessor> p);
 
 private:
+  // a signal which is part of m_allSignals until its end time
+  struct PendingSignal
+  {
+    Time m_endTime;
+    uint64_t m_id;      // order of arrival, to remove simultaneous signals in FIFO order
+    Ptr<const SpectrumValue> m_psd;
+
+    bool operator > (const PendingSignal &other) const
+    {
+      return m_endTime > other.m_endTime || (m_endTime == other.m_endTime && m_id > other.m_id);
+    }
+  };
+
   void ConditionallyEvaluateChunk ();
-  void DoAddSignal (Ptr<const SpectrumValue> spd);
-  void DoSubtractSignal  (Ptr<const SpectrumValue> spd, uint32_t signalId);
+  void EvaluateChunk (Time now);
+  void SubtractEndedSignals ();
   std::list<Ptr<mmWaveChunkProcessor> > m_PowerChunkProcessorList;
   std::list<Ptr<mmWaveChunkProcessor> > m_sinrChunkProcessorList;
 
@@ -69,11 +84,12 @@ private:
   Ptr<SpectrumValue> m_rxSignal;
   Ptr<SpectrumValue> m_allSignals;
   Ptr<const SpectrumValue> m_noise;
+  Ptr<SpectrumValue> m_sinr;          // buffer of the SINR of the last chunk
 
   Time m_lastChangeTime;
 
-  uint32_t m_lastSignalId;
-  uint32_t m_lastSignalIdBeforeReset;
+  uint64_t m_lastSignalId;
+  std::priority_queue<PendingSignal, std::vector<PendingSignal>, std::greater<PendingSignal> > m_pendingSignals;
 };
 
 } // namespace mmwave
@@ -50,83 +50,88 @@ namespace ns3 {
 namespace mmwave {
 
 
+/**
+ * The MI map of a modulation. The values of the axis are uniformly spaced,
+ * therefore the index of a SINR value is
+ * ((sinrLin - value[0]) / (value[SIZE-1] - value[0])) * (SIZE-1)
+ * and the scaling coefficient is computed once.
+ */
+struct MiMap
+{
+  const double *m_mi;       //!< the MI values
+  const double *m_axis;     //!< the SINR values
+  uint16_t m_size;          //!< the number of values
+  double m_scalingCoeff;    //!< (SIZE-1) / (value[SIZE-1] - value[0])
+};
+
+static const MiMap g_miMapQpsk = {MI_map_qpsk, MI_map_qpsk_axis, MMWAVE_MI_MAP_QPSK_SIZE,
+                                  (MMWAVE_MI_MAP_QPSK_SIZE - 1) / (MI_map_qpsk_axis[MMWAVE_MI_MAP_QPSK_SIZE - 1] - MI_map_qpsk_axis[0])};
+static const MiMap g_miMap16qam = {MI_map_16qam, MI_map_16qam_axis, MMWAVE_MI_MAP_16QAM_SIZE,
+                                   (MMWAVE_MI_MAP_16QAM_SIZE - 1) / (MI_map_16qam_axis[MMWAVE_MI_MAP_16QAM_SIZE - 1] - MI_map_16qam_axis[0])};
+static const MiMap g_miMap64qam = {MI_map_64qam, MI_map_64qam_axis, MMWAVE_MI_MAP_64QAM_SIZE,
+                                   (MMWAVE_MI_MAP_64QAM_SIZE - 1) / (MI_map_64qam_axis[MMWAVE_MI_MAP_64QAM_SIZE - 1] - MI_map_64qam_axis[0])};
+
+/**
+ * The b and c coefficients of the BLER curves, for each CB size index and
+ * ECR id. A missing coefficient is replaced by the one of the lowest larger
+ * CB size which has it, to remove CB size quantization errors.
+ */
+struct BlerCoefficients
+{
+  BlerCoefficients ()
+  {
+    for (int cbIndex = 0; cbIndex < 9; cbIndex++)
+      {
+        for (int ecrId = 0; ecrId <= MMWAVE_MI_64QAM_BLER_MAX_ID; ecrId++)
+          {
+            double b = bEcrTable[cbIndex][ecrId];
+            int i = cbIndex;
+            while ((i < 9)&&(b < 0))
+              {
+                b = bEcrTable[i++][ecrId];
+              }
+            double c = cEcrTable[cbIndex][ecrId];
+            i = cbIndex;
+            while ((i < 9)&&(c < 0))
+              {
+                c = cEcrTable[i++][ecrId];
+              }
+            m_b[cbIndex][ecrId] = b;
+            m_c[cbIndex][ecrId] = c;
+          }
+      }
+  }
+
+  double m_b[9][MMWAVE_MI_64QAM_BLER_MAX_ID + 1]; //!< the b coefficients
+  double m_c[9][MMWAVE_MI_64QAM_BLER_MAX_ID + 1]; //!< the c coefficients
+};
+
+static const BlerCoefficients g_blerCoefficients;
+
 double
 MmWaveMiErrorModel::Mib (const SpectrumValue& sinr, const std::vector<int>& map, uint8_t mcs)
 {
   NS_LOG_FUNCTION (sinr << &map << (uint32_t) mcs);
 
+  // the modulation is the same for all the RBs
+  const MiMap &miMap = mcs <= MMWAVE_MI_QPSK_MAX_ID ? g_miMapQpsk
+    : (mcs <= MMWAVE_MI_16QAM_MAX_ID ? g_miMap16qam : g_miMap64qam);
+  const double maxSinr = miMap.m_axis[miMap.m_size - 1];
+  const double minSinr = miMap.m_axis[0];
+  const double *values = &(*sinr.ConstValuesBegin ());
+
   double MI;
   double MIsum = 0.0;
-  SpectrumValue sinrCopy = sinr;
-
-  for (uint32_t i = 0; i < map.size (); i++)
+  for (std::vector<int>::const_iterator it = map.begin (); it != map.end (); ++it)
     {
-      double sinrLin = sinrCopy[map.at (i)];
-      if (mcs <= MMWAVE_MI_QPSK_MAX_ID) // QPSK
-        {
-
-          if (sinrLin > MI_map_qpsk_axis[MMWAVE_MI_MAP_QPSK_SIZE - 1])
-            {
-              MI = 1;
-            }
-          else
-            {
-              // since the values in MI_map_qpsk_axis are uniformly spaced, we have
-              // index = ((sinrLin - value[0]) / (value[SIZE-1] - value[0])) * (SIZE-1)
-              // the scaling coefficient is always the same, so we use a static const
-              // to speed up the calculation
-              static const double scalingCoeffQpsk =
-                (MMWAVE_MI_MAP_QPSK_SIZE - 1) / (MI_map_qpsk_axis[MMWAVE_MI_MAP_QPSK_SIZE - 1] - MI_map_qpsk_axis[0]);
-              double sinrIndexDouble = (sinrLin -  MI_map_qpsk_axis[0]) * scalingCoeffQpsk + 1;
-              uint32_t sinrIndex = std::max (0.0, std::floor (sinrIndexDouble));
-              NS_ASSERT_MSG (sinrIndex < MMWAVE_MI_MAP_QPSK_SIZE, "MI map out of data");
-              MI = MI_map_qpsk[sinrIndex];
-            }
-        }
-      else
-        {
-          if (mcs > MMWAVE_MI_QPSK_MAX_ID && mcs <= MMWAVE_MI_16QAM_MAX_ID )    // 16-QAM
-            {
-              if (sinrLin > MI_map_16qam_axis[MMWAVE_MI_MAP_16QAM_SIZE - 1])
-                {
-                  MI = 1;
-                }
-              else
-                {
-                  // since the values in MI_map_16QAM_axis are uniformly spaced, we have
-                  // index = ((sinrLin - value[0]) / (value[SIZE-1] - value[0])) * (SIZE-1)
-                  // the scaling coefficient is always the same, so we use a static const
-                  // to speed up the calculation
-                  static const double scalingCoeff16qam =
-                    (MMWAVE_MI_MAP_16QAM_SIZE - 1) / (MI_map_16qam_axis[MMWAVE_MI_MAP_16QAM_SIZE - 1] - MI_map_16qam_axis[0]);
-                  double sinrIndexDouble = (sinrLin -  MI_map_16qam_axis[0]) * scalingCoeff16qam + 1;
-                  uint32_t sinrIndex = std::max (0.0, std::floor (sinrIndexDouble));
-                  NS_ASSERT_MSG (sinrIndex < MMWAVE_MI_MAP_16QAM_SIZE, "MI map out of data");
-                  MI = MI_map_16qam[sinrIndex];
-                }
-            }
-          else // 64-QAM
-            {
-              if (sinrLin > MI_map_64qam_axis[MMWAVE_MI_MAP_64QAM_SIZE - 1])
-                {
-                  MI = 1;
-                }
-              else
-                {
-                  // since the values in MI_map_64QAM_axis are uniformly spaced, we have
-                  // index = ((sinrLin - value[0]) / (value[SIZE-1] - value[0])) * (SIZE-1)
-                  // the scaling coefficient is always the same, so we use a static const
-                  // to speed up the calculation
-                  static const double scalingCoeff64qam =
-                    (MMWAVE_MI_MAP_64QAM_SIZE - 1) / (MI_map_64qam_axis[MMWAVE_MI_MAP_64QAM_SIZE - 1] - MI_map_64qam_axis[0]);
-                  double sinrIndexDouble = (sinrLin -  MI_map_64qam_axis[0]) * scalingCoeff64qam + 1;
-                  uint32_t sinrIndex = std::max (0.0, std::floor (sinrIndexDouble));
-                  NS_ASSERT_MSG (sinrIndex < MMWAVE_MI_MAP_64QAM_SIZE, "MI map out of data");
-                  MI = MI_map_64qam[sinrIndex];
-                }
-            }
-        }
-      NS_LOG_LOGIC (" RB " << map.at (i) << "Minimum SNR = " << 10 * std::log10 (sinrLin) << " dB, " << sinrLin << " V, MCS = " << (uint16_t)mcs << ", MI = " << MI);
+      double sinrLin = values[*it];
+      // the index is not used above the map, the clamp only keeps it in the
+      // range of uint32_t
+      double sinrIndexDouble = (std::min (sinrLin, maxSinr) - minSinr) * miMap.m_scalingCoeff + 1;
+      uint32_t sinrIndex = std::max (0.0, std::floor (sinrIndexDouble));
+      NS_ASSERT_MSG (sinrLin > maxSinr || sinrIndex < miMap.m_size, "MI map out of data");
+      MI = sinrLin > maxSinr ? 1 : miMap.m_mi[sinrIndex];
+      NS_LOG_LOGIC (" RB " << *it << "Minimum SNR = " << 10 * std::log10 (sinrLin) << " dB, " << sinrLin << " V, MCS = " << (uint16_t)mcs << ", MI = " << MI);
       MIsum += MI;
     }
   MI = MIsum / map.size ();
@@ -139,8 +144,6 @@ double
 MmWaveMiErrorModel::MappingMiBler (double mib, uint8_t ecrId, uint32_t cbSize)
 {
   NS_LOG_FUNCTION (mib << (uint32_t) ecrId << (uint32_t) cbSize);
-  double b = 0;
-  double c = 0;
 
   NS_ASSERT_MSG (ecrId <= MMWAVE_MI_64QAM_BLER_MAX_ID, "ECR out of range [0..37]: " << (uint16_t) ecrId);
   int cbIndex = 1;
@@ -151,28 +154,8 @@ MmWaveMiErrorModel::MappingMiBler (double mib, uint8_t ecrId, uint32_t cbSize)
   cbIndex--;
   NS_LOG_LOGIC (" ECRid " << (uint16_t)ecrId << " ECR " << BlerCurvesEcrMap[ecrId] << " CB size " << cbSize << " CB size curve " << cbMiSizeTable[cbIndex]);
 
-  b = bEcrTable[cbIndex][ecrId];
-  if (b < 0.0)
-    {
-      //take the lowest CB size including this CB for removing CB size
-      //quatization errors
-      int i = cbIndex;
-      while ((i < 9)&&(b < 0))
-        {
-          b = bEcrTable[i++][ecrId];
-        }
-    }
-  c = cEcrTable[cbIndex][ecrId];
-  if (c < 0.0)
-    {
-      //take the lowest CB size including this CB for removing CB size
-      //quatization errors
-      int i = cbIndex;
-      while ((i < 9)&&(c < 0))
-        {
-          c = cEcrTable[i++][ecrId];
-        }
-    }
+  double b = g_blerCoefficients.m_b[cbIndex][ecrId];
+  double c = g_blerCoefficients.m_c[cbIndex][ecrId];
   // see IEEE802.16m EMD formula 55 of section 4.3.2.1
   double bler = 0.5 * ( 1 - erf ((mib - b) / (sqrt (2) * c)) );
   NS_LOG_LOGIC ("MIB: " << mib << " BLER:" << bler << " b:" << b << " c:" << c);
@@ -0,0 +1,230 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*/
+
+#include "ns3/mmwave-mi-error-model.h"
+#include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/double.h"
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveMiErrorModelTest");
+
+using namespace ns3;
+using namespace mmwave;
+
+/**
+* This test case checks that MmWaveMiErrorModel::Mib and
+* MmWaveMiErrorModel::MappingMiBler return exactly the same values as their
+* reference implementations, which evaluate the modulation and the BLER
+* curve coefficients separately for each RB and each call
+*/
+class MmWaveMiErrorModelTestCase : public TestCase
+{
+public:
+  /**
+  * Constructor
+  */
+  MmWaveMiErrorModelTestCase ();
+
+  /**
+  * Destructor
+  */
+  virtual ~MmWaveMiErrorModelTestCase ();
+
+private:
+  /**
+  * Run the test
+  */
+  virtual void DoRun (void);
+
+  /**
+  * Reference implementation of MmWaveMiErrorModel::Mib
+  * \param sinr the perceived sinrs in the whole bandwidth
+  * \param map the actives RBs for the TB
+  * \param mcs the MCS of the TB
+  * \return the mmib
+  */
+  static double ReferenceMib (const SpectrumValue& sinr, const std::vector<int>& map, uint8_t mcs);
+
+  /**
+  * Reference implementation of MmWaveMiErrorModel::MappingMiBler
+  * \param mib mean mutual information per bit of a code-block
+  * \param ecrId Effective Code Rate ID
+  * \param cbSize the size of the CB
+  * \return the code block error rate
+  */
+  static double ReferenceMappingMiBler (double mib, uint8_t ecrId, uint32_t cbSize);
+};
+
+MmWaveMiErrorModelTestCase::MmWaveMiErrorModelTestCase ()
+  : TestCase ("Checks that the MI error model matches its reference implementation")
+{
+}
+
+MmWaveMiErrorModelTestCase::~MmWaveMiErrorModelTestCase ()
+{
+}
+
+double
+MmWaveMiErrorModelTestCase::ReferenceMib (const SpectrumValue& sinr, const std::vector<int>& map, uint8_t mcs)
+{
+  double MIsum = 0.0;
+  for (uint32_t i = 0; i < map.size (); i++)
+    {
+      double sinrLin = sinr[map.at (i)];
+      const double *mi;
+      const double *axis;
+      uint16_t size;
+      if (mcs <= MMWAVE_MI_QPSK_MAX_ID)
+        {
+          mi = MI_map_qpsk;
+          axis = MI_map_qpsk_axis;
+          size = MMWAVE_MI_MAP_QPSK_SIZE;
+        }
+      else if (mcs <= MMWAVE_MI_16QAM_MAX_ID)
+        {
+          mi = MI_map_16qam;
+          axis = MI_map_16qam_axis;
+          size = MMWAVE_MI_MAP_16QAM_SIZE;
+        }
+      else
+        {
+          mi = MI_map_64qam;
+          axis = MI_map_64qam_axis;
+          size = MMWAVE_MI_MAP_64QAM_SIZE;
+        }
+
+      if (sinrLin > axis[size - 1])
+        {
+          MIsum += 1;
+        }
+      else
+        {
+          double scalingCoeff = (size - 1) / (axis[size - 1] - axis[0]);
+          double sinrIndexDouble = (sinrLin - axis[0]) * scalingCoeff + 1;
+          uint32_t sinrIndex = std::max (0.0, std::floor (sinrIndexDouble));
+          MIsum += mi[sinrIndex];
+        }
+    }
+  return MIsum / map.size ();
+}
+
+double
+MmWaveMiErrorModelTestCase::ReferenceMappingMiBler (double mib, uint8_t ecrId, uint32_t cbSize)
+{
+  int cbIndex = 1;
+  while ((cbIndex < 9)&&(cbMiSizeTable[cbIndex] <= cbSize))
+    {
+      cbIndex++;
+    }
+  cbIndex--;
+
+  double b = bEcrTable[cbIndex][ecrId];
+  int i = cbIndex;
+  while ((i < 9)&&(b < 0))
+    {
+      b = bEcrTable[i++][ecrId];
+    }
+  double c = cEcrTable[cbIndex][ecrId];
+  i = cbIndex;
+  while ((i < 9)&&(c < 0))
+    {
+      c = cEcrTable[i++][ecrId];
+    }
+  return 0.5 * ( 1 - erf ((mib - b) / (sqrt (2) * c)) );
+}
+
+void
+MmWaveMiErrorModelTestCase::DoRun (void)
+{
+  const uint32_t numRbs = 72;
+  Bands bands;
+  for (uint32_t i = 0; i < numRbs; i++)
+    {
+      BandInfo band;
+      band.fl = 28e9 + i * 1e6;
+      band.fc = band.fl + 0.5e6;
+      band.fh = band.fl + 1e6;
+      bands.push_back (band);
+    }
+  Ptr<SpectrumModel> model = Create<SpectrumModel> (bands);
+
+  Ptr<UniformRandomVariable> sinrDb = CreateObject<UniformRandomVariable> ();
+  sinrDb->SetAttribute ("Min", DoubleValue (-20.0));
+  sinrDb->SetAttribute ("Max", DoubleValue (40.0));
+  sinrDb->SetStream (1);
+  Ptr<UniformRandomVariable> rb = CreateObject<UniformRandomVariable> ();
+  rb->SetStream (2);
+
+  for (uint32_t run = 0; run < 50; run++)
+    {
+      SpectrumValue sinr (model);
+      for (uint32_t i = 0; i < numRbs; i++)
+        {
+          sinr[i] = std::pow (10, sinrDb->GetValue () / 10);
+        }
+      // include the values on the boundaries of the maps
+      sinr[0] = 2 * MI_map_qpsk_axis[MMWAVE_MI_MAP_QPSK_SIZE - 1];
+      sinr[1] = MI_map_16qam_axis[0];
+      sinr[2] = 0;
+
+      std::vector<int> map;
+      uint32_t firstRb = rb->GetInteger (0, numRbs - 1);
+      uint32_t lastRb = rb->GetInteger (firstRb, numRbs - 1);
+      for (uint32_t i = firstRb; i <= lastRb; i++)
+        {
+          map.push_back (i);
+        }
+
+      for (uint8_t mcs = 0; mcs < 29; mcs++)
+        {
+          double mib = MmWaveMiErrorModel::Mib (sinr, map, mcs);
+          NS_TEST_ASSERT_MSG_EQ (mib, ReferenceMib (sinr, map, mcs), "Wrong MI for MCS " << (uint16_t) mcs);
+        }
+    }
+
+  for (uint8_t ecrId = 0; ecrId <= MMWAVE_MI_64QAM_BLER_MAX_ID; ecrId++)
+    {
+      for (uint32_t cbSize = 40; cbSize <= 6144; cbSize += 37)
+        {
+          for (double mib = 0.0; mib <= 1.0; mib += 0.03125)
+            {
+              NS_TEST_ASSERT_MSG_EQ (MmWaveMiErrorModel::MappingMiBler (mib, ecrId, cbSize),
+                                     ReferenceMappingMiBler (mib, ecrId, cbSize),
+                                     "Wrong BLER for ECR " << (uint16_t) ecrId << " CB size " << cbSize);
+            }
+        }
+    }
+}
+
+/**
+* Test suite for the MmWaveMiErrorModel
+*/
+class MmWaveMiErrorModelTestSuite : public TestSuite
+{
+public:
+  MmWaveMiErrorModelTestSuite ();
+};
+
+MmWaveMiErrorModelTestSuite::MmWaveMiErrorModelTestSuite ()
+  : TestSuite ("mmwave-mi-error-model-test", UNIT)
+{
+  AddTestCase (new MmWaveMiErrorModelTestCase, TestCase::QUICK);
+}
+
+static MmWaveMiErrorModelTestSuite mmwaveMiErrorModelTestSuite;
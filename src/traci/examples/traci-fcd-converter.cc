@@ -0,0 +1,43 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Convert a SUMO fcd output (sumo --fcd-output <file>) into a binary trace
+ * file, which the TraciClient replays without SUMO when its attribute
+ * FcdTracePath is set:
+ *
+ * ./waf --run "traci-fcd-converter --input=sumoTrace.xml --output=sumoTrace.fcd"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/fcd-trace.h"
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+  std::string input;
+  std::string output;
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "SUMO fcd output", input);
+  cmd.AddValue ("output", "Binary trace file", output);
+  cmd.Parse (argc, argv);
+
+  if (input == "" || output == "")
+    {
+      NS_FATAL_ERROR ("Both --input and --output are required");
+    }
+
+  FcdTrace::ConvertFromXml (input, output);
+
+  Ptr<FcdTrace> trace = Create<FcdTrace> (output);
+  std::cout << output << ": " << trace->GetNumFrames () << " time steps, "
+            << trace->GetNumVehicles () << " vehicles" << std::endl;
+  if (trace->GetNumFrames () > 0)
+    {
+      std::cout << "time " << trace->GetFrame (0).time << " s to "
+                << trace->GetFrame (trace->GetNumFrames () - 1).time << " s" << std::endl;
+    }
+  return 0;
+}
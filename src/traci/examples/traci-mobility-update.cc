@@ -0,0 +1,163 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * This example compares the MobilityUpdate modes of the TraciClient without
+ * running sumo. A vehicle drives around a circle with a periodically varying
+ * speed; at every synchronisation the node receives the position, speed and
+ * angle the vehicle has one synch interval later, as the TraciClient does, and
+ * the node position is compared every 10 ms with the true trajectory. The mean
+ * and maximum position errors are printed for every mode and synch interval.
+ *
+ * ./waf --run "traci-mobility-update --radius=100 --speed=13.9"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/traci-client.h"
+#include <cmath>
+#include <iomanip>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TraciMobilityUpdate");
+
+static double g_radius = 100; // radius of the track, in m
+static double g_speed = 13.9; // mean speed, in m/s
+static double g_speedVariation = 5; // amplitude of the speed variation, in m/s
+static double g_speedPeriod = 20; // period of the speed variation, in s
+
+// distance driven on the track at time t
+static double
+GetDistance (double t)
+{
+  double w = 2 * M_PI / g_speedPeriod;
+  return g_speed * t + g_speedVariation / w * (1 - std::cos (w * t));
+}
+
+// true position of the vehicle at time t
+static Vector
+GetPosition (double t, double altitude)
+{
+  double theta = GetDistance (t) / g_radius;
+  return Vector (g_radius * std::cos (theta), g_radius * std::sin (theta), altitude);
+}
+
+// sumo speed and angle (degrees clockwise from north) of the vehicle at time t
+static void
+GetSpeedAngle (double t, double &speed, double &angle)
+{
+  double theta = GetDistance (t) / g_radius;
+  speed = g_speed + g_speedVariation * std::sin (2 * M_PI * t / g_speedPeriod);
+  angle = std::atan2 (-std::sin (theta), std::cos (theta)) * 180 / M_PI;
+}
+
+struct ErrorStats
+{
+  double sum = 0;
+  double max = 0;
+  uint32_t samples = 0;
+};
+
+// emulate TraciClient::UpdatePositions for the single vehicle
+static void
+Synchronise (Ptr<MobilityModel> mob, TraciClient::MobilityUpdate mode, Time interval, double sampleTime,
+             bool first, Vector *position, Vector *velocity)
+{
+  double speed;
+  double angle;
+  GetSpeedAngle (sampleTime, speed, angle);
+  Vector nextPosition = GetPosition (sampleTime, 1.5);
+  Vector nextVelocity = TraciClient::GetVelocity (speed, angle);
+  if (first)
+    {
+      double dt = interval.GetSeconds ();
+      *position = Vector (nextPosition.x - nextVelocity.x * dt, nextPosition.y - nextVelocity.y * dt, 1.5);
+      *velocity = nextVelocity;
+    }
+  TraciClient::SetMobility (mob, mode, *position, *velocity, nextPosition, interval);
+  *position = nextPosition;
+  *velocity = nextVelocity;
+}
+
+static void
+SumoSimulationStep (Ptr<MobilityModel> mob, TraciClient::MobilityUpdate mode, Time interval,
+                    Vector *position, Vector *velocity)
+{
+  // sumo simulates until the end of the next synch interval
+  Synchronise (mob, mode, interval, (Simulator::Now () + interval).GetSeconds (), false, position, velocity);
+  Simulator::Schedule (interval, &SumoSimulationStep, mob, mode, interval, position, velocity);
+}
+
+static void
+SampleError (Ptr<MobilityModel> mob, ErrorStats *stats)
+{
+  Vector truth = GetPosition (Simulator::Now ().GetSeconds (), 1.5);
+  double error = CalculateDistance (mob->GetPosition (), truth);
+  stats->sum += error;
+  stats->max = std::max (stats->max, error);
+  stats->samples++;
+  Simulator::Schedule (MilliSeconds (10), &SampleError, mob, stats);
+}
+
+static ErrorStats
+RunMode (TraciClient::MobilityUpdate mode, Time interval, Time duration)
+{
+  Ptr<ConstantVelocityMobilityModel> mob = CreateObject<ConstantVelocityMobilityModel> ();
+  Vector position;
+  Vector velocity;
+  ErrorStats stats;
+
+  // the setup reads the vehicle state at the start time
+  Synchronise (mob, mode, interval, 0, true, &position, &velocity);
+  Simulator::Schedule (interval, &SumoSimulationStep, mob, mode, interval, &position, &velocity);
+  // skip the first synch intervals: the setup is not one synch interval ahead, and the
+  // first state of the vehicle is extrapolated
+  Simulator::Schedule (3 * interval, &SampleError, mob, &stats);
+
+  Simulator::Stop (duration);
+  Simulator::Run ();
+  Simulator::Destroy ();
+  return stats;
+}
+
+int
+main (int argc, char *argv[])
+{
+  double duration = 200;
+
+  CommandLine cmd;
+  cmd.AddValue ("radius", "Radius of the track, in m", g_radius);
+  cmd.AddValue ("speed", "Mean speed of the vehicle, in m/s", g_speed);
+  cmd.AddValue ("speedVariation", "Amplitude of the speed variation, in m/s", g_speedVariation);
+  cmd.AddValue ("speedPeriod", "Period of the speed variation, in s", g_speedPeriod);
+  cmd.AddValue ("duration", "Simulated time for every run, in s", duration);
+  cmd.Parse (argc, argv);
+
+  std::vector<double> intervals = {0.01, 0.1, 0.25, 0.5, 1.0, 2.0};
+  std::vector<std::pair<TraciClient::MobilityUpdate, std::string> > modes = {
+    {TraciClient::UPDATE_POSITION, "Position"},
+    {TraciClient::UPDATE_VELOCITY, "Velocity"},
+    {TraciClient::UPDATE_LINEAR, "Linear"}};
+
+  std::cout << std::setw (10) << "interval";
+  for (auto &mode : modes)
+    {
+      std::cout << std::setw (20) << mode.second + " mean/max";
+    }
+  std::cout << std::endl;
+
+  for (double interval : intervals)
+    {
+      std::cout << std::setw (10) << interval;
+      for (auto &mode : modes)
+        {
+          ErrorStats stats = RunMode (mode.first, Seconds (interval), Seconds (duration));
+          std::ostringstream os;
+          os << std::fixed << std::setprecision (3) << stats.sum / stats.samples << "/" << stats.max;
+          std::cout << std::setw (20) << os.str ();
+        }
+      std::cout << std::endl;
+    }
+
+  return 0;
+}
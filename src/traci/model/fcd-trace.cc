@@ -0,0 +1,398 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ns3/log.h"
+#include "ns3/fatal-error.h"
+
+#include "fcd-trace.h"
+
+namespace ns3
+{
+  NS_LOG_COMPONENT_DEFINE("FcdTrace");
+
+  const char FcdTrace::s_magic[8] = {'N', 'S', '3', 'F', 'C', 'D', 0, 0};
+
+  // get the value of an attribute of a xml tag; returns false if the tag has no such attribute
+  static bool
+  GetXmlAttribute(const std::string& tag, const char* name, std::string& value)
+  {
+    std::string key = std::string(" ") + name + "=\"";
+    std::string::size_type start = tag.find(key);
+    if (start == std::string::npos)
+      {
+        return false;
+      }
+    start += key.size();
+    std::string::size_type end = tag.find('"', start);
+    if (end == std::string::npos)
+      {
+        return false;
+      }
+    value = tag.substr(start, end - start);
+    return true;
+  }
+
+  static double
+  GetXmlDouble(const std::string& tag, const char* name)
+  {
+    std::string value;
+    if (!GetXmlAttribute(tag, name, value))
+      {
+        NS_FATAL_ERROR("Missing attribute " << name << " in fcd output element <" << tag << ">");
+      }
+    return std::strtod(value.c_str(), 0);
+  }
+
+  // append the records of a time step, sorted by vehicle index, to the trace file
+  static void
+  WriteFrame(std::ofstream& out, std::vector<FcdTrace::Record>& records, std::vector<FcdTrace::Frame>& frames,
+             uint64_t& numRecords)
+  {
+    if (frames.empty())
+      {
+        return;
+      }
+    std::sort(records.begin(), records.end(),
+              [](const FcdTrace::Record& a, const FcdTrace::Record& b) { return a.vehicle < b.vehicle; });
+    frames.back().firstRecord = numRecords;
+    frames.back().numRecords = records.size();
+    out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(FcdTrace::Record));
+    numRecords += records.size();
+    records.clear();
+  }
+
+  void
+  FcdTrace::ConvertFromXml(const std::string& xmlPath, const std::string& binaryPath)
+  {
+    NS_LOG_FUNCTION(xmlPath << binaryPath);
+
+    std::ifstream in(xmlPath);
+    if (!in)
+      {
+        NS_FATAL_ERROR("Can not open the fcd output " << xmlPath);
+      }
+
+    // write into a temporary file, which replaces the trace file only once it is complete
+    std::string tmpPath = binaryPath + ".tmp" + std::to_string(getpid());
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+      {
+        NS_FATAL_ERROR("Can not create the trace file " << tmpPath);
+      }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<Frame> frames;
+    std::vector<Record> records;
+    std::vector<std::string> vehicleIds;
+    std::unordered_map<std::string, uint32_t> vehicleIndex;
+    uint64_t numRecords = 0;
+
+    // every chunk up to a '>' ends with a tag; sumo writes a time step as <timestep time="..."> followed by an
+    // empty <vehicle id="..." x="..." y="..." angle="..." speed="..." .../> element per vehicle
+    std::string chunk;
+    while (std::getline(in, chunk, '>'))
+      {
+        std::string::size_type start = chunk.find('<');
+        if (start == std::string::npos)
+          {
+            continue;
+          }
+        std::string tag = chunk.substr(start + 1);
+
+        if (tag.compare(0, 9, "timestep ") == 0)
+          {
+            WriteFrame(out, records, frames, numRecords);
+            Frame frame;
+            std::memset(&frame, 0, sizeof(frame));
+            frame.time = GetXmlDouble(tag, "time");
+            if (!frames.empty() && frame.time <= frames.back().time)
+              {
+                NS_FATAL_ERROR("The time steps of the fcd output " << xmlPath << " are not increasing");
+              }
+            frames.push_back(frame);
+          }
+        else if (tag.compare(0, 8, "vehicle ") == 0)
+          {
+            if (frames.empty())
+              {
+                NS_FATAL_ERROR("Vehicle outside of a time step in the fcd output " << xmlPath);
+              }
+            std::string id;
+            if (!GetXmlAttribute(tag, "id", id))
+              {
+                NS_FATAL_ERROR("Vehicle without id in the fcd output " << xmlPath);
+              }
+
+            std::unordered_map<std::string, uint32_t>::iterator it = vehicleIndex.find(id);
+            if (it == vehicleIndex.end())
+              {
+                it = vehicleIndex.insert(std::make_pair(id, vehicleIds.size())).first;
+                vehicleIds.push_back(id);
+              }
+
+            Record record;
+            std::memset(&record, 0, sizeof(record));
+            record.x = GetXmlDouble(tag, "x");
+            record.y = GetXmlDouble(tag, "y");
+            record.speed = GetXmlDouble(tag, "speed");
+            record.angle = GetXmlDouble(tag, "angle");
+            record.vehicle = it->second;
+            records.push_back(record);
+          }
+      }
+    WriteFrame(out, records, frames, numRecords);
+
+    header.recordsOffset = sizeof(Header);
+    header.framesOffset = out.tellp();
+    out.write(reinterpret_cast<const char*>(frames.data()), frames.size() * sizeof(Frame));
+
+    std::vector<uint64_t> idOffsets(1, 0);
+    std::string idChars;
+    for (const std::string& id : vehicleIds)
+      {
+        idChars += id;
+        idOffsets.push_back(idChars.size());
+      }
+    header.idOffsetsOffset = out.tellp();
+    out.write(reinterpret_cast<const char*>(idOffsets.data()), idOffsets.size() * sizeof(uint64_t));
+    header.idCharsOffset = out.tellp();
+    out.write(idChars.data(), idChars.size());
+
+    std::memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = s_version;
+    header.numVehicles = vehicleIds.size();
+    header.numFrames = frames.size();
+    header.numRecords = numRecords;
+    header.fileSize = out.tellp();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out)
+      {
+        NS_FATAL_ERROR("Can not write the trace file " << tmpPath);
+      }
+
+    if (std::rename(tmpPath.c_str(), binaryPath.c_str()) != 0)
+      {
+        NS_FATAL_ERROR("Can not rename " << tmpPath << " to " << binaryPath);
+      }
+    NS_LOG_INFO("Converted " << frames.size() << " time steps of " << vehicleIds.size() << " vehicles into " << binaryPath);
+  }
+
+  FcdTrace::FcdTrace(const std::string& path)
+    : m_map(MAP_FAILED),
+      m_mapSize(0)
+  {
+    NS_LOG_FUNCTION(this << path);
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      {
+        NS_FATAL_ERROR("Can not open the trace file " << path);
+      }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+      {
+        NS_FATAL_ERROR("The trace file " << path << " is too short");
+      }
+    m_mapSize = st.st_size;
+    m_map = mmap(0, m_mapSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_map == MAP_FAILED)
+      {
+        NS_FATAL_ERROR("Can not map the trace file " << path);
+      }
+
+    const char* base = static_cast<const char*>(m_map);
+    m_header = reinterpret_cast<const Header*>(base);
+    if (std::memcmp(m_header->magic, s_magic, sizeof(s_magic)) != 0 || m_header->version != s_version)
+      {
+        NS_FATAL_ERROR(path << " is not a trace file of this version");
+      }
+    if (m_header->fileSize != m_mapSize
+        || m_header->recordsOffset + m_header->numRecords * sizeof(Record) > m_header->framesOffset
+        || m_header->framesOffset + m_header->numFrames * sizeof(Frame) > m_header->idOffsetsOffset
+        || m_header->idOffsetsOffset + (m_header->numVehicles + 1) * sizeof(uint64_t) > m_header->idCharsOffset
+        || m_header->idCharsOffset > m_mapSize)
+      {
+        NS_FATAL_ERROR("The trace file " << path << " is corrupted");
+      }
+
+    m_records = reinterpret_cast<const Record*>(base + m_header->recordsOffset);
+    m_frames = reinterpret_cast<const Frame*>(base + m_header->framesOffset);
+    m_idOffsets = reinterpret_cast<const uint64_t*>(base + m_header->idOffsetsOffset);
+    m_idChars = base + m_header->idCharsOffset;
+    for (uint32_t i = 0; i < m_header->numVehicles; ++i)
+      {
+        if (m_idOffsets[i] > m_idOffsets[i + 1])
+          {
+            NS_FATAL_ERROR("The trace file " << path << " is corrupted: the id of vehicle " << i << " ends before it starts");
+          }
+      }
+    if (m_idOffsets[m_header->numVehicles] > m_mapSize - m_header->idCharsOffset)
+      {
+        NS_FATAL_ERROR("The trace file " << path << " is corrupted: the vehicle ids exceed the file");
+      }
+
+    // the accessors index the records and the ids without checks
+    for (uint32_t i = 0; i < m_header->numFrames; ++i)
+      {
+        const Frame& frame = m_frames[i];
+        if (frame.firstRecord > m_header->numRecords || frame.numRecords > m_header->numRecords - frame.firstRecord)
+          {
+            NS_FATAL_ERROR("The trace file " << path << " is corrupted: the records of time step " << i << " exceed the file");
+          }
+      }
+    for (uint64_t i = 0; i < m_header->numRecords; ++i)
+      {
+        if (m_records[i].vehicle >= m_header->numVehicles)
+          {
+            NS_FATAL_ERROR("The trace file " << path << " is corrupted: record " << i << " has an unknown vehicle");
+          }
+      }
+
+    m_vehicleIndex.reserve(m_header->numVehicles);
+    for (uint32_t i = 0; i < m_header->numVehicles; ++i)
+      {
+        m_vehicleIndex[GetVehicleId(i)] = i;
+      }
+  }
+
+  FcdTrace::~FcdTrace(void)
+  {
+    NS_LOG_FUNCTION(this);
+    if (m_map != MAP_FAILED)
+      {
+        munmap(m_map, m_mapSize);
+      }
+  }
+
+  uint32_t
+  FcdTrace::GetNumFrames(void) const
+  {
+    return m_header->numFrames;
+  }
+
+  uint32_t
+  FcdTrace::GetNumVehicles(void) const
+  {
+    return m_header->numVehicles;
+  }
+
+  const FcdTrace::Frame&
+  FcdTrace::GetFrame(uint32_t frame) const
+  {
+    NS_ASSERT(frame < m_header->numFrames);
+    return m_frames[frame];
+  }
+
+  const FcdTrace::Record*
+  FcdTrace::GetRecords(uint32_t frame) const
+  {
+    return m_records + GetFrame(frame).firstRecord;
+  }
+
+  int64_t
+  FcdTrace::FindFrame(double time) const
+  {
+    // tolerate the rounding of the time steps written by sumo
+    const Frame* end = m_frames + m_header->numFrames;
+    const Frame* it = std::upper_bound(m_frames, end, time + 1e-6,
+                                       [](double t, const Frame& frame) { return t < frame.time; });
+    return (it - m_frames) - 1;
+  }
+
+  const FcdTrace::Record*
+  FcdTrace::FindRecord(int64_t frame, uint32_t vehicle) const
+  {
+    if (frame < 0)
+      {
+        return 0;
+      }
+    const Record* begin = GetRecords(frame);
+    const Record* end = begin + GetFrame(frame).numRecords;
+    const Record* it = std::lower_bound(begin, end, vehicle,
+                                        [](const Record& record, uint32_t v) { return record.vehicle < v; });
+    return (it != end && it->vehicle == vehicle) ? it : 0;
+  }
+
+  std::string
+  FcdTrace::GetVehicleId(uint32_t vehicle) const
+  {
+    NS_ASSERT(vehicle < m_header->numVehicles);
+    return std::string(m_idChars + m_idOffsets[vehicle], m_idOffsets[vehicle + 1] - m_idOffsets[vehicle]);
+  }
+
+  bool
+  FcdTrace::GetVehicleIndex(const std::string& id, uint32_t& vehicle) const
+  {
+    std::unordered_map<std::string, uint32_t>::const_iterator it = m_vehicleIndex.find(id);
+    if (it == m_vehicleIndex.end())
+      {
+        return false;
+      }
+    vehicle = it->second;
+    return true;
+  }
+
+  void
+  FcdTrace::GetChanges(int64_t from, int64_t to, std::vector<std::string>& departed,
+                       std::vector<std::string>& arrived) const
+  {
+    departed.clear();
+    arrived.clear();
+
+    const Record* a = (from < 0) ? 0 : GetRecords(from);
+    const Record* aEnd = (from < 0) ? 0 : a + GetFrame(from).numRecords;
+    const Record* b = (to < 0) ? 0 : GetRecords(to);
+    const Record* bEnd = (to < 0) ? 0 : b + GetFrame(to).numRecords;
+
+    // both time steps are sorted by vehicle index
+    while (a != aEnd || b != bEnd)
+      {
+        if (b == bEnd || (a != aEnd && a->vehicle < b->vehicle))
+          {
+            arrived.push_back(GetVehicleId(a->vehicle));
+            ++a;
+          }
+        else if (a == aEnd || b->vehicle < a->vehicle)
+          {
+            departed.push_back(GetVehicleId(b->vehicle));
+            ++b;
+          }
+        else
+          {
+            ++a;
+            ++b;
+          }
+      }
+  }
+
+} // namespace ns3
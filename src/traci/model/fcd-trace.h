@@ -0,0 +1,117 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FCD_TRACE_H
+#define FCD_TRACE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "ns3/simple-ref-count.h"
+
+namespace ns3 {
+
+// Vehicle trajectories recorded by sumo with --fcd-output, converted into a binary file which is memory-mapped
+// read-only, so that the trajectories are replayed without sumo and the pages are shared by parallel simulations.
+// The file is written with the byte order of the host: a header, the records of all time steps, the time steps and
+// the vehicle ids. The records of a time step are sorted by vehicle index.
+class FcdTrace : public SimpleRefCount<FcdTrace>
+{
+public:
+  // state of a vehicle in a time step
+  struct Record
+  {
+    double x;
+    double y;
+    double speed;    // m/s
+    double angle;    // degrees clockwise from north, as in sumo
+    uint32_t vehicle; // index of the vehicle id
+    uint32_t reserved;
+  };
+
+  // time step of the trace
+  struct Frame
+  {
+    double time;          // sumo time, in seconds
+    uint64_t firstRecord; // index of the first record of the time step
+    uint32_t numRecords;  // number of vehicles in the time step
+    uint32_t reserved;
+  };
+
+  // map the binary file; aborts if it is not a valid trace
+  FcdTrace(const std::string& path);
+  ~FcdTrace(void);
+
+  // convert a sumo fcd output into a binary trace file
+  static void ConvertFromXml(const std::string& xmlPath, const std::string& binaryPath);
+
+  uint32_t GetNumFrames(void) const;
+  uint32_t GetNumVehicles(void) const;
+  const Frame& GetFrame(uint32_t frame) const;
+  const Record* GetRecords(uint32_t frame) const;
+
+  // index of the last time step not after time, or -1 if the trace starts later
+  int64_t FindFrame(double time) const;
+
+  // record of a vehicle in a time step, or null if the vehicle is not in the time step
+  const Record* FindRecord(int64_t frame, uint32_t vehicle) const;
+
+  std::string GetVehicleId(uint32_t vehicle) const;
+  // returns false if the vehicle is not in the trace
+  bool GetVehicleIndex(const std::string& id, uint32_t& vehicle) const;
+
+  // vehicles which are in the time step to but not in the time step from (departed), and vice versa (arrived);
+  // a time step of -1 has no vehicles
+  void GetChanges(int64_t from, int64_t to, std::vector<std::string>& departed, std::vector<std::string>& arrived) const;
+
+private:
+  // layout of the file header
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t numVehicles;
+    uint32_t numFrames;
+    uint32_t reserved;
+    uint64_t numRecords;
+    uint64_t recordsOffset;
+    uint64_t framesOffset;
+    uint64_t idOffsetsOffset; // numVehicles + 1 offsets of the ids in the id characters
+    uint64_t idCharsOffset;
+    uint64_t fileSize;
+  };
+
+  static const char s_magic[8];
+  static const uint32_t s_version = 1;
+
+  void* m_map;
+  size_t m_mapSize;
+  const Header* m_header;
+  const Record* m_records;
+  const Frame* m_frames;
+  const uint64_t* m_idOffsets;
+  const char* m_idChars;
+
+  // vehicle id to vehicle index
+  std::unordered_map<std::string, uint32_t> m_vehicleIndex;
+};
+
+} // end namespace ns3
+
+#endif /* FCD_TRACE_H */
@@ -87,6 +87,7 @@ TraCIAPI::connect(const std::string& host, int port) {
 
 void
 TraCIAPI::setOrder(int order) {
+    waitForSocket();
     tcpip::Storage outMsg;
     // command length
     outMsg.writeUnsignedByte(1 + 1 + 4);
@@ -123,6 +124,7 @@ TraCIAPI::closeSocket() {
 
 void
 TraCIAPI::send_commandSimulationStep(double time) const {
+    waitForSocket();
     tcpip::Storage outMsg;
     // command length
     outMsg.writeUnsignedByte(1 + 1 + 8);
@@ -136,6 +138,7 @@ TraCIAPI::send_commandSimulationStep(double time) const {
 
 void
 TraCIAPI::send_commandClose() const {
+    waitForSocket();
     tcpip::Storage outMsg;
     // command length
     outMsg.writeUnsignedByte(1 + 1);
@@ -147,6 +150,7 @@ TraCIAPI::send_commandClose() const {
 
 void
 TraCIAPI::send_commandSetOrder(int order) const {
+    waitForSocket();
     tcpip::Storage outMsg;
     // command length
     outMsg.writeUnsignedByte(1 + 1 + 4);
@@ -160,6 +164,7 @@ TraCIAPI::send_commandSetOrder(int order) const {
 
 void
 TraCIAPI::createCommand(int cmdID, int varID, const std::string& objID, tcpip::Storage* add) const {
+    waitForSocket();
     myOutput.reset();
     // command length
     int length = 1 + 1 + 1 + 4 + (int) objID.length();
@@ -184,6 +189,7 @@ TraCIAPI::createCommand(int cmdID, int varID, const std::string& objID, tcpip::S
 
 void
 TraCIAPI::createFilterCommand(int cmdID, int varID, tcpip::Storage* add) const {
+    waitForSocket();
     myOutput.reset();
     // command length
     int length = 1 + 1 + 1;
@@ -208,6 +214,7 @@ TraCIAPI::createFilterCommand(int cmdID, int varID, tcpip::Storage* add) const {
 void
 TraCIAPI::send_commandSubscribeObjectVariable(int domID, const std::string& objID, double beginTime, double endTime,
         const std::vector<int>& vars) const {
+    waitForSocket();
     if (mySocket == nullptr) {
         throw tcpip::SocketException("Socket is not initialised");
     }
@@ -236,6 +243,7 @@ TraCIAPI::send_commandSubscribeObjectVariable(int domID, const std::string& objI
 void
 TraCIAPI::send_commandSubscribeObjectContext(int domID, const std::string& objID, double beginTime, double endTime,
         int domain, double range, const std::vector<int>& vars) const {
+    waitForSocket();
     if (mySocket == nullptr) {
         throw tcpip::SocketException("Socket is not initialised");
     }
@@ -467,6 +475,7 @@ TraCIAPI::simulationStep(double time) {
 
 void
 TraCIAPI::load(const std::vector<std::string>& args) {
+    waitForSocket();
     int numChars = 0;
     for (int i = 0; i < (int)args.size(); ++i) {
         numChars += (int)args[i].size();
@@ -485,6 +494,7 @@ TraCIAPI::load(const std::vector<std::string>& args) {
 
 std::pair<int, std::string>
 TraCIAPI::getVersion() {
+    waitForSocket();
     tcpip::Storage content;
     content.writeUnsignedByte(2);
     content.writeUnsignedByte(libsumo::CMD_GETVERSION);
@@ -925,6 +925,9 @@ protected:
     void closeSocket();
 
 protected:
+    /// @brief Called before a command is written, e.g. to wait until another thread is done with the connection
+    virtual void waitForSocket() const {}
+
     std::map<int, TraCIScopeWrapper*> myDomains;
     /// @brief The socket
     tcpip::Socket* mySocket;
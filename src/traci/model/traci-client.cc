@@ -21,12 +21,15 @@
  */
 
 #include <exception>
+#include <cmath>
 #include <algorithm>
 #include <unistd.h>
 #include <iostream>
 #include <fstream>
 #include <regex>
 #include <string>
+#include <unordered_set>
+#include <stdexcept>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
@@ -86,6 +89,12 @@ namespace ns3
                   BooleanValue (false),
                   MakeBooleanAccessor (&TraciClient::m_sumoStepLog),
                   MakeBooleanChecker ())
+    .AddAttribute ("SumoSubscriptions",
+                  "Subscribe every vehicle to its position, speed and angle, so that they are received with the "
+                  "simulation step response, instead of asking sumo for the position of every vehicle at every step.",
+                  BooleanValue (true),
+                  MakeBooleanAccessor (&TraciClient::m_sumoSubscriptions),
+                  MakeBooleanChecker ())
     .AddAttribute ("SynchInterval",
                   "Time interval for synchronizing the two simulators.",
                   TimeValue (ns3::Seconds(1.0)),
@@ -96,6 +105,31 @@ namespace ns3
                   TimeValue (ns3::Seconds(0.0)),
                   MakeTimeAccessor (&TraciClient::m_startTime),
                   MakeTimeChecker ())
+    .AddAttribute ("AsyncStepping",
+                  "Simulate the next SUMO step on a background thread while ns3 processes the current synch interval. "
+                  "The same commands are sent to SUMO in the same order, so the results do not change, unless other TraCI "
+                  "commands are issued during the simulation, e.g., by a TrafficControlApplication: such a command waits "
+                  "until the background step is done, hence it applies to SUMO one synch interval later than without "
+                  "AsyncStepping.",
+                  BooleanValue (false),
+                  MakeBooleanAccessor (&TraciClient::m_asyncStepping),
+                  MakeBooleanChecker ())
+    .AddAttribute ("FcdTracePath",
+                  "Path to a binary trace file, converted from a SUMO --fcd-output with FcdTrace::ConvertFromXml, "
+                  "whose vehicle trajectories are replayed instead of running SUMO.",
+                  StringValue (""),
+                  MakeStringAccessor (&TraciClient::m_fcdTracePath),
+                  MakeStringChecker ())
+    .AddAttribute ("MobilityUpdate",
+                  "How the node mobility is updated at every synchronisation: Position only sets the position which "
+                  "sumo computed for the end of the synch interval; Velocity sets the current position and the speed and "
+                  "heading of the vehicle; Linear moves the node linearly between consecutive sumo positions. Velocity and "
+                  "Linear require a ConstantVelocityMobilityModel on the nodes.",
+                  EnumValue (TraciClient::UPDATE_POSITION),
+                  MakeEnumAccessor (&TraciClient::m_mobilityUpdate),
+                  MakeEnumChecker (TraciClient::UPDATE_POSITION, "Position",
+                                   TraciClient::UPDATE_VELOCITY, "Velocity",
+                                   TraciClient::UPDATE_LINEAR, "Linear"))
     .AddAttribute ("PenetrationRate", "Rate of vehicles, equipped with wireless communication devices",
                   DoubleValue (1.0),
                   MakeDoubleAccessor (&TraciClient::m_penetrationRate),
@@ -120,7 +154,16 @@ namespace ns3
     m_penetrationRate = 1.0;
     m_sumoLogFile = false;
     m_sumoStepLog = false;
+    m_sumoSubscriptions = true;
+    m_mobilityUpdate = UPDATE_POSITION;
+    m_fcdFrame = -1;
+    m_fcdPreviousFrame = -1;
     m_sumoWaitForSocket = ns3::Seconds(1.0);
+    m_asyncStepping = false;
+    m_stepTime = 0;
+    m_stepRequested = false;
+    m_stepDone = false;
+    m_stepThreadStop = false;
   }
 
   TraciClient::~TraciClient(void)
@@ -134,6 +177,20 @@ namespace ns3
   {
     NS_LOG_FUNCTION(this);
 
+    // a replay has no connection to sumo
+    if (m_fcdTrace || m_fcdTracePath != "")
+      {
+        m_fcdTrace = 0;
+        return;
+      }
+
+    // wait for the step simulated in advance, which is not needed anymore; if it failed, sumo has already quit
+    if (StopStepThread())
+      {
+        this->TraCIAPI::closeSocket();
+        return;
+      }
+
     try
       {
         this->TraCIAPI::close();
@@ -149,19 +206,13 @@ namespace ns3
   {
     NS_LOG_FUNCTION(this);
 
-    std::string foundVeh("");
-
-    // search map for corresponding node
-    for (std::map<std::string, Ptr<Node> >::iterator it = m_vehicleNodeMap.begin(); it != m_vehicleNodeMap.end(); ++it)
+    // look up the reverse index for the corresponding vehicle
+    std::unordered_map<uint32_t, std::string>::const_iterator it = m_nodeVehicleMap.find(node->GetId());
+    if (it == m_nodeVehicleMap.end())
       {
-        if (it->second == node)
-          {
-            foundVeh = it->first;
-            break;
-          }
+        return "";
       }
-
-    return foundVeh;
+    return it->second;
   }
 
   std::string
@@ -229,10 +280,23 @@ namespace ns3
   {
     NS_LOG_FUNCTION(this);
 
-    m_sumoPort = GetFreePort(m_sumoPort);
-
     m_includeNode = includeNode;
     m_excludeNode = excludeNode;
+
+    // replay the fcd trace instead of running sumo
+    if (m_fcdTracePath != "")
+      {
+        m_fcdTrace = Create<FcdTrace>(m_fcdTracePath);
+        m_fcdFrame = -1;
+        m_fcdPreviousFrame = -1;
+        FcdTraceStep(m_startTime.GetSeconds());
+        SynchroniseVehicleNodeMap();
+        UpdatePositions();
+        Simulator::Schedule(m_synchInterval, &TraciClient::SumoSimulationStep, this);
+        return;
+      }
+
+    m_sumoPort = GetFreePort(m_sumoPort);
     m_sumoCommand = GetSumoCmdString();
 
     // start up sumo
@@ -257,7 +321,14 @@ namespace ns3
       }
 
     // start sumo and simulate until the specified time
-    this->TraCIAPI::simulationStep(m_startTime.GetSeconds());
+    try
+      {
+        DoSumoStep(m_startTime.GetSeconds(), m_sumoStep);
+      }
+    catch (std::exception& e)
+      {
+        NS_FATAL_ERROR("Sumo was closed unexpectedly during simulation: " << e.what());
+      }
 
     // synchronise sumo vehicles with ns3 nodes
     SynchroniseVehicleNodeMap();
@@ -265,6 +336,12 @@ namespace ns3
     // get current positions from sumo and uptdate positions
     UpdatePositions();
 
+    // let sumo simulate the step of the first synchronisation while ns3 runs
+    if (m_asyncStepping)
+      {
+        IssueSumoStep(GetNextSumoTime(Simulator::Now() + m_synchInterval));
+      }
+
     // schedule event to command sumo the next simulation step
     Simulator::Schedule(m_synchInterval, &TraciClient::SumoSimulationStep, this);
   }
@@ -277,10 +354,21 @@ namespace ns3
     try
       {
         // get current simulation time
-        auto nextTime = Simulator::Now().GetSeconds() + m_synchInterval.GetSeconds() + m_startTime.GetSeconds();
+        auto nextTime = GetNextSumoTime(Simulator::Now());
 
-        // command sumo to simulate next time step
-        this->TraCIAPI::simulationStep(nextTime);
+        // command sumo to simulate next time step, or take the step simulated in the background
+        if (m_fcdTrace)
+          {
+            FcdTraceStep(nextTime);
+          }
+        else if (m_asyncStepping)
+          {
+            WaitForSumoStep(nextTime);
+          }
+        else
+          {
+            DoSumoStep(nextTime, m_sumoStep);
+          }
 
         // include a ns3 node for every new sumo vehicle and exclude arrived vehicles
         SynchroniseVehicleNodeMap();
@@ -288,6 +376,12 @@ namespace ns3
         // ask sumo for new vehicle positions and update node positions
         UpdatePositions();
 
+        // the vehicles are subscribed and the positions read: sumo can simulate the next step in the background
+        if (m_asyncStepping && !m_fcdTrace)
+          {
+            IssueSumoStep(GetNextSumoTime(Simulator::Now() + m_synchInterval));
+          }
+
         // schedule next event to simulate next time step in sumo
         Simulator::Schedule(m_synchInterval, &TraciClient::SumoSimulationStep, this);
       }
@@ -304,19 +398,86 @@ namespace ns3
 
     try
       {
+        // subscription results received with the last simulation step response and with the new subscriptions
+        const libsumo::SubscriptionResults& results = this->TraCIAPI::vehicle.getModifiableSubscriptionResults();
+
+        // speed and heading are only needed to move the nodes between synchronisations
+        bool velocity = (m_mobilityUpdate != UPDATE_POSITION);
+
         // iterate over all sumo vehicles in map
         for (std::map<std::string, Ptr<Node> >::iterator it = m_vehicleNodeMap.begin(); it != m_vehicleNodeMap.end(); ++it)
           {
             // get current sumo vehicle from map
-            std::string veh(it->first);
-
-            // get vehicle position from sumo
-            libsumo::TraCIPosition pos(this->TraCIAPI::vehicle.getPosition(veh));
+            const std::string& veh(it->first);
+
+            // get vehicle position, speed and angle from the subscription results, or ask sumo for them
+            libsumo::TraCIPosition pos;
+            double speed = 0;
+            double angle = 0;
+            libsumo::SubscriptionResults::const_iterator res = results.find(veh);
+            if (m_fcdTrace)
+              {
+                // the state of the vehicle in the current time step of the replayed trace
+                uint32_t index = 0;
+                const FcdTrace::Record* record = 0;
+                if (m_fcdTrace->GetVehicleIndex(veh, index))
+                  {
+                    record = m_fcdTrace->FindRecord(m_fcdFrame, index);
+                  }
+                if (!record)
+                  {
+                    NS_FATAL_ERROR("Vehicle " << veh << " is not in the current time step of the fcd trace");
+                  }
+                pos.x = record->x;
+                pos.y = record->y;
+                speed = record->speed;
+                angle = record->angle;
+              }
+            else if (m_sumoSubscriptions && res != results.end() && res->second.count(libsumo::VAR_POSITION))
+              {
+                pos = *std::static_pointer_cast<libsumo::TraCIPosition>(res->second.at(libsumo::VAR_POSITION));
+                if (velocity)
+                  {
+                    speed = std::static_pointer_cast<libsumo::TraCIDouble>(res->second.at(libsumo::VAR_SPEED))->value;
+                    angle = std::static_pointer_cast<libsumo::TraCIDouble>(res->second.at(libsumo::VAR_ANGLE))->value;
+                  }
+              }
+            else
+              {
+                pos = this->TraCIAPI::vehicle.getPosition(veh);
+                if (velocity)
+                  {
+                    speed = this->TraCIAPI::vehicle.getSpeed(veh);
+                    angle = this->TraCIAPI::vehicle.getAngle(veh);
+                  }
+              }
 
             // get corresponding ns3 node from map
-            Ptr<MobilityModel> mob = m_vehicleNodeMap.at(veh)->GetObject<MobilityModel>();
+            Ptr<MobilityModel> mob = it->second->GetObject<MobilityModel>();
             // set ns3 node position with user defined altitude
-            mob->SetPosition(Vector(pos.x, pos.y, m_altitude));
+            Vector nextPosition(pos.x, pos.y, m_altitude);
+            if (!velocity)
+              {
+                mob->SetPosition(nextPosition);
+                continue;
+              }
+
+            // sumo is one synch interval ahead: start from the last received state, or, for a new vehicle, from the
+            // position it had one synch interval earlier at its current velocity
+            Vector nextVelocity = GetVelocity(speed, angle);
+            std::map<std::string, VehicleState>::iterator state = m_vehicleStates.find(veh);
+            if (state == m_vehicleStates.end())
+              {
+                double dt = m_synchInterval.GetSeconds();
+                VehicleState first;
+                first.position = Vector(nextPosition.x - nextVelocity.x * dt, nextPosition.y - nextVelocity.y * dt, m_altitude);
+                first.velocity = nextVelocity;
+                state = m_vehicleStates.insert(std::make_pair(veh, first)).first;
+              }
+            SetMobility(mob, m_mobilityUpdate, state->second.position, state->second.velocity, nextPosition, m_synchInterval);
+
+            state->second.position = nextPosition;
+            state->second.velocity = nextVelocity;
           }
       }
     catch (std::exception& e)
@@ -325,6 +486,196 @@ namespace ns3
       }
   }
 
+  void
+  TraciClient::SetMobility(Ptr<MobilityModel> mob, MobilityUpdate mode, const Vector& position, const Vector& velocity,
+                           const Vector& nextPosition, Time interval)
+  {
+    if (mode == UPDATE_POSITION)
+      {
+        mob->SetPosition(nextPosition);
+        return;
+      }
+
+    Ptr<ConstantVelocityMobilityModel> cvMob = DynamicCast<ConstantVelocityMobilityModel>(mob);
+    if (!cvMob)
+      {
+        NS_FATAL_ERROR("The MobilityUpdate modes Velocity and Linear require a ConstantVelocityMobilityModel, the node has a "
+                       << mob->GetInstanceTypeId().GetName());
+      }
+
+    cvMob->SetPosition(position);
+    if (mode == UPDATE_VELOCITY || interval.IsZero())
+      {
+        cvMob->SetVelocity(velocity);
+      }
+    else
+      {
+        double dt = interval.GetSeconds();
+        cvMob->SetVelocity(Vector((nextPosition.x - position.x) / dt, (nextPosition.y - position.y) / dt,
+                                  (nextPosition.z - position.z) / dt));
+      }
+  }
+
+  Vector
+  TraciClient::GetVelocity(double speed, double angle)
+  {
+    // sumo angles are measured clockwise from the north, i.e., from the y axis
+    double rad = angle * M_PI / 180;
+    return Vector(speed * std::sin(rad), speed * std::cos(rad), 0);
+  }
+
+  void
+  TraciClient::FcdTraceStep(double time)
+  {
+    NS_LOG_FUNCTION(this << time);
+
+    m_fcdPreviousFrame = m_fcdFrame;
+    m_fcdFrame = m_fcdTrace->FindFrame(time);
+    m_fcdTrace->GetChanges(m_fcdPreviousFrame, m_fcdFrame, m_sumoStep.departed, m_sumoStep.arrived);
+  }
+
+  double
+  TraciClient::GetNextSumoTime(Time now) const
+  {
+    // a step issued in advance has the same time as the step of the synchronisation at now
+    return now.GetSeconds() + m_synchInterval.GetSeconds() + m_startTime.GetSeconds();
+  }
+
+  void
+  TraciClient::DoSumoStep(double time, SumoStep& step)
+  {
+    // command sumo to simulate until time; the response contains the subscription results
+    this->TraCIAPI::simulationStep(time);
+
+    // ask sumo for all (new) departed and arrived vehicles SINCE last simulation step (=one synch interval)
+    step.departed = this->TraCIAPI::simulation.getDepartedIDList();
+    step.arrived = this->TraCIAPI::simulation.getArrivedIDList();
+    step.time = time;
+    step.error = "";
+  }
+
+  void
+  TraciClient::RunStepThread(void)
+  {
+    std::unique_lock<std::mutex> lock(m_stepMutex);
+    while (true)
+      {
+        m_stepCondition.wait(lock, [this] () { return m_stepRequested || m_stepThreadStop; });
+        if (!m_stepRequested)
+          {
+            return;
+          }
+        double time = m_stepTime;
+        lock.unlock();
+
+        // the main thread does not use the connection until the step is done
+        try
+          {
+            DoSumoStep(time, m_pendingStep);
+          }
+        catch (std::exception& e)
+          {
+            m_pendingStep.time = time;
+            m_pendingStep.error = e.what();
+          }
+
+        lock.lock();
+        m_stepRequested = false;
+        m_stepDone = true;
+        m_stepCondition.notify_all();
+      }
+  }
+
+  void
+  TraciClient::IssueSumoStep(double time)
+  {
+    NS_LOG_FUNCTION(this << time);
+
+    if (!m_stepThread.joinable())
+      {
+        m_stepThreadStop = false;
+        m_stepThread = std::thread(&TraciClient::RunStepThread, this);
+      }
+
+    std::lock_guard<std::mutex> lock(m_stepMutex);
+    NS_ASSERT_MSG(!m_stepRequested, "A sumo step is already running in the background");
+    m_stepTime = time;
+    m_stepRequested = true;
+    m_stepDone = false;
+    m_stepCondition.notify_all();
+  }
+
+  void
+  TraciClient::WaitForSumoStep(double time)
+  {
+    NS_LOG_FUNCTION(this << time);
+
+    {
+      std::unique_lock<std::mutex> lock(m_stepMutex);
+      NS_ASSERT_MSG(m_stepRequested || m_stepDone, "No sumo step was issued");
+      m_stepCondition.wait(lock, [this] () { return m_stepDone; });
+      m_stepDone = false;
+    }
+
+    // swap the buffers: the background thread fills the other one with the next step
+    std::swap(m_sumoStep, m_pendingStep);
+    NS_ASSERT_MSG(m_sumoStep.time == time, "The background sumo step is not the expected one");
+    if (m_sumoStep.error != "")
+      {
+        throw std::runtime_error(m_sumoStep.error);
+      }
+  }
+
+  void
+  TraciClient::waitForSocket() const
+  {
+    // the background thread owns the connection while a step is running: the other commands wait until it is done
+    if (!m_stepThread.joinable() || std::this_thread::get_id() == m_stepThread.get_id())
+      {
+        return;
+      }
+
+    std::unique_lock<std::mutex> lock(m_stepMutex);
+    if (m_stepRequested)
+      {
+        NS_LOG_LOGIC("TraCI command issued while a sumo step is running in the background, wait for the step");
+        m_stepCondition.wait(lock, [this] () { return !m_stepRequested; });
+      }
+  }
+
+  bool
+  TraciClient::StopStepThread(void)
+  {
+    NS_LOG_FUNCTION(this);
+
+    if (!m_stepThread.joinable())
+      {
+        return false;
+      }
+
+    bool failed = false;
+    {
+      std::unique_lock<std::mutex> lock(m_stepMutex);
+      m_stepCondition.wait(lock, [this] () { return !m_stepRequested; });
+      failed = m_stepDone && m_pendingStep.error != "";
+      m_stepDone = false;
+      m_stepThreadStop = true;
+      m_stepCondition.notify_all();
+    }
+    m_stepThread.join();
+    return failed;
+  }
+
+  void
+  TraciClient::SubscribeVehicle(const std::string& veh)
+  {
+    NS_LOG_FUNCTION(this << veh);
+
+    // the subscription lasts until the vehicle arrives; the response already contains the current values
+    std::vector<int> vars = {libsumo::VAR_POSITION, libsumo::VAR_SPEED, libsumo::VAR_ANGLE};
+    this->TraCIAPI::vehicle.subscribe(veh, vars, libsumo::INVALID_DOUBLE_VALUE, libsumo::INVALID_DOUBLE_VALUE);
+  }
+
   void
   TraciClient::GetSumoVehicles(std::vector<std::string>& sumoVehicles)
   {
@@ -338,25 +689,26 @@ namespace ns3
 
     try
       {
-        // ask sumo for all (new) departed vehicles SINCE last simulation step (=one synch interval)
-        std::vector<std::string> departedVehicles = this->TraCIAPI::simulation.getDepartedIDList();
+        // all (new) departed vehicles SINCE last simulation step (=one synch interval)
+        const std::vector<std::string>& departedVehicles = m_sumoStep.departed;
+
+        // all (new) arrived vehicles SINCE last simulation step (=one synch interval)
+        const std::vector<std::string>& arrivedVehicles = m_sumoStep.arrived;
 
-        // ask sumo for all (new) arrived vehicles SINCE last simulation step (=one synch interval)
-        std::vector<std::string> arrivedVehicles = this->TraCIAPI::simulation.getArrivedIDList();
+        // vehicles which departed and arrived within the same synch interval are ignored
+        std::unordered_set<std::string> arrivedSet(arrivedVehicles.begin(), arrivedVehicles.end());
+        std::unordered_set<std::string> transientVehicles;
 
         // iterate over departed vehicles
-        for (std::vector<std::string>::iterator it = departedVehicles.begin(); it != departedVehicles.end(); ++it)
+        for (std::vector<std::string>::const_iterator it = departedVehicles.begin(); it != departedVehicles.end(); ++it)
           {
             // get departed vehicle
-            std::string veh(*it);
-
-            // search for same vehicle in arrived vehicles
-            std::vector<std::string>::iterator pos = std::find(arrivedVehicles.begin(), arrivedVehicles.end(), veh);
+            const std::string& veh(*it);
 
             // if vehicle is found in both lists, ignore it; all others are considered as relevant vehicles for simulation
-            if (pos != arrivedVehicles.end())
+            if (arrivedSet.count(veh))
               {
-                arrivedVehicles.erase(pos);
+                transientVehicles.insert(veh);
               }
             else
               {
@@ -369,16 +721,13 @@ namespace ns3
           }
 
         // iterate over arrived vehicles
-        for (std::vector<std::string>::iterator it = arrivedVehicles.begin(); it != arrivedVehicles.end(); ++it)
+        for (std::vector<std::string>::const_iterator it = arrivedVehicles.begin(); it != arrivedVehicles.end(); ++it)
           {
             // get arrived vehicle
-            std::string veh(*it);
-
-            // search for arrived vehicle in vehicleNodeMap
-            std::map<std::string, Ptr<Node> >::iterator pos = m_vehicleNodeMap.find(veh);
+            const std::string& veh(*it);
 
             // if node is in map, exclude it, otherwise is was not simulated in ns3 because of the penetration rate
-            if (pos != m_vehicleNodeMap.end())
+            if (!transientVehicles.count(veh) && m_vehicleNodeMap.count(veh))
               {
                 sumoVehicles.push_back(veh);
               }
@@ -405,7 +754,7 @@ namespace ns3
         for (std::vector<std::string>::iterator it = sumoVehicles.begin(); it != sumoVehicles.end(); ++it)
           {
             // get current vehicle
-            std::string veh(*it);
+            const std::string& veh(*it);
 
             // search for vehicle in vehicleNodeMap
             std::map<std::string, Ptr<Node> >::iterator pos = m_vehicleNodeMap.find(veh);
@@ -414,13 +763,22 @@ namespace ns3
             if (pos != m_vehicleNodeMap.end())
               {
                 // get corresponding ns3 node
-                Ptr<ns3::Node> exNode = m_vehicleNodeMap.at(veh);
+                Ptr<ns3::Node> exNode = pos->second;
+
+                // stop the node before calling the exclude function
+                Ptr<ConstantVelocityMobilityModel> cvMob = exNode->GetObject<ConstantVelocityMobilityModel>();
+                if (m_mobilityUpdate != UPDATE_POSITION && cvMob)
+                  {
+                    cvMob->SetVelocity(Vector(0, 0, 0));
+                  }
 
-                // call exclude function for this node
+                // call exclude function for this node; it may still ask for the vehicle of the node
                 m_excludeNode(exNode);
 
-                // unregister in map
-                m_vehicleNodeMap.erase(veh);
+                // unregister in map and in the reverse index
+                m_vehicleNodeMap.erase(pos);
+                m_nodeVehicleMap.erase(exNode->GetId());
+                m_vehicleStates.erase(veh);
               }
             else // if it is not in the map, create a new ns3 node for it
               {
@@ -429,6 +787,13 @@ namespace ns3
 
                 // register in the map (link vehicle to node!)
                 m_vehicleNodeMap.insert(std::pair<std::string, Ptr<Node>>(veh, inNode));
+                m_nodeVehicleMap[inNode->GetId()] = veh;
+
+                // receive its position with every simulation step response
+                if (m_sumoSubscriptions && !m_fcdTrace)
+                  {
+                    SubscribeVehicle(veh);
+                  }
                  //std::cout<<"\n A new node is created with ID "<<veh<<std::endl;
               }
           }
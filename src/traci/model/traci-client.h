@@ -24,9 +24,13 @@
 #define TRACI_H
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <signal.h>
 #include <stdlib.h>
@@ -37,12 +41,21 @@
 
 #include "sumo-TraCIAPI.h"
 #include "sumo-TraCIDefs.h"
+#include "fcd-trace.h"
 
 namespace ns3 {
 
 class TraciClient : public TraCIAPI, public Object
 {
 public:
+  // how the mobility model of a node is updated at every synchronisation
+  enum MobilityUpdate
+  {
+    UPDATE_POSITION, // set the position which sumo computed for the end of the next synch interval
+    UPDATE_VELOCITY, // set the current position and velocity, and move with constant velocity until the next synch
+    UPDATE_LINEAR    // set the current position, and move linearly to the position at the end of the next synch interval
+  };
+
   // register this type with the TypeId system.
   static TypeId GetTypeId (void);
 
@@ -59,8 +72,18 @@ public:
   std::string GetVehicleId(Ptr<Node> node);
 
   uint32_t GetVehicleMapSize(); // size of vehicle map
+
+  // update the mobility of a node at a synchronisation; position and velocity are the vehicle state at the current
+  // time, nextPosition is the position at the end of the synch interval; the modes other than UPDATE_POSITION
+  // abort if mob is not a ConstantVelocityMobilityModel
+  static void SetMobility(Ptr<MobilityModel> mob, MobilityUpdate mode, const Vector& position, const Vector& velocity,
+                          const Vector& nextPosition, Time interval);
+
+  // velocity of a vehicle in ns3 coordinates from its sumo speed (m/s) and angle (degrees clockwise from north)
+  static Vector GetVelocity(double speed, double angle);
   
-    // map every sumo vehicle to a ns3 node
+    // map every sumo vehicle to a ns3 node; it is ordered, so that the nodes are always updated in the same order,
+  // and it is only modified by the client, which keeps the reverse index in sync
   std::map< std::string, Ptr<Node> > m_vehicleNodeMap;
 
 private:
@@ -70,6 +93,38 @@ private:
   // get current positions from sumo vehicles and update corresponding ns3 nodes positions
   void UpdatePositions(void);
 
+  // advance the replayed fcd trace to the last time step not after time
+  void FcdTraceStep(double time);
+
+  // departed and arrived vehicles of a sumo simulation step
+  struct SumoStep
+  {
+    double time = 0;
+    std::vector<std::string> departed;
+    std::vector<std::string> arrived;
+    std::string error; // exception thrown by a step simulated in the background
+  };
+
+  // sumo time simulated by the synchronisation at the ns3 time now
+  double GetNextSumoTime(Time now) const;
+
+  // command sumo to simulate until time and ask for the departed and arrived vehicles
+  void DoSumoStep(double time, SumoStep& step);
+
+  // background simulation of the sumo steps, which overlaps with the ns3 events of a synch interval
+  void RunStepThread(void);
+  void IssueSumoStep(double time);
+  // wait for the step issued in the background and swap it in
+  void WaitForSumoStep(double time);
+  // returns true if the last step issued in the background failed
+  bool StopStepThread(void);
+
+  // called by TraCIAPI before every command: a command issued while a step runs in the background waits for it
+  virtual void waitForSocket() const;
+
+  // subscribe a sumo vehicle to the variables read at every simulation step
+  void SubscribeVehicle(const std::string& veh);
+
   // get new (departed) and removed (arrived) vehicles from sumo
   void GetSumoVehicles(std::vector<std::string>& sumoVehicles);
 
@@ -82,6 +137,17 @@ private:
   // map every sumo vehicle to a ns3 node
   //std::map< std::string, Ptr<Node> > m_vehicleNodeMap;
 
+  // reverse index of the vehicle node map: ns3 node id to sumo vehicle
+  std::unordered_map<uint32_t, std::string> m_nodeVehicleMap;
+
+  // last position and velocity received from sumo for every vehicle in the map
+  struct VehicleState
+  {
+    Vector position;
+    Vector velocity;
+  };
+  std::map<std::string, VehicleState> m_vehicleStates;
+
   // a vehicle is untracked if it is simulated in sumo but not linked to a ns3 node because of an penetration rate < 1.0
   std::vector<std::string> m_untrackedVehicles;
 
@@ -107,10 +173,31 @@ private:
   
   bool m_sumoLogFile;
   bool m_sumoStepLog;
+  bool m_sumoSubscriptions;
+  MobilityUpdate m_mobilityUpdate;
   double m_altitude;
   int m_sumoSeed;
   ns3::Time m_sumoWaitForSocket;
 
+  // double buffer of the sumo steps: the step applied to the nodes, and the one simulated in the background
+  SumoStep m_sumoStep;
+  SumoStep m_pendingStep;
+
+  bool m_asyncStepping;
+  std::thread m_stepThread;
+  mutable std::mutex m_stepMutex;
+  mutable std::condition_variable m_stepCondition;
+  double m_stepTime;
+  bool m_stepRequested;
+  bool m_stepDone;
+  bool m_stepThreadStop;
+
+  // replayed fcd trace and its current and previous time steps
+  std::string m_fcdTracePath;
+  Ptr<FcdTrace> m_fcdTrace;
+  int64_t m_fcdFrame;
+  int64_t m_fcdPreviousFrame;
+
 };
 
 } // end namespace ns3
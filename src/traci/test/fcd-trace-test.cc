@@ -0,0 +1,214 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+#include "ns3/fcd-trace.h"
+#include "ns3/traci-client.h"
+#include <fstream>
+
+using namespace ns3;
+
+// fcd output of three vehicles in four time steps; veh1 arrives after 1 s, veh2 departs at 1 s
+static const char* g_fcdOutput =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<fcd-export xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
+  "    <timestep time=\"0.00\">\n"
+  "        <vehicle id=\"veh0\" x=\"10.00\" y=\"20.00\" angle=\"90.00\" type=\"car\" speed=\"10.00\" pos=\"5.10\" lane=\"e_0\" slope=\"0.00\"/>\n"
+  "        <vehicle id=\"veh1\" x=\"0.00\" y=\"5.00\" angle=\"0.00\" type=\"car\" speed=\"2.00\" pos=\"5.10\" lane=\"e_1\" slope=\"0.00\"/>\n"
+  "    </timestep>\n"
+  "    <timestep time=\"1.00\">\n"
+  "        <vehicle id=\"veh2\" x=\"-3.50\" y=\"0.00\" angle=\"180.00\" type=\"car\" speed=\"0.00\" pos=\"0.00\" lane=\"f_0\" slope=\"0.00\"/>\n"
+  "        <vehicle id=\"veh0\" x=\"20.00\" y=\"20.00\" angle=\"90.00\" type=\"car\" speed=\"10.00\" pos=\"15.10\" lane=\"e_0\" slope=\"0.00\"/>\n"
+  "        <vehicle id=\"veh1\" x=\"0.00\" y=\"7.00\"\n"
+  "                 angle=\"0.00\" type=\"car\" speed=\"2.00\" pos=\"7.10\" lane=\"e_1\" slope=\"0.00\"/>\n"
+  "    </timestep>\n"
+  "    <timestep time=\"2.00\">\n"
+  "        <vehicle id=\"veh0\" x=\"30.00\" y=\"20.00\" angle=\"90.00\" type=\"car\" speed=\"10.00\" pos=\"25.10\" lane=\"e_0\" slope=\"0.00\"/>\n"
+  "        <vehicle id=\"veh2\" x=\"-3.50\" y=\"-4.00\" angle=\"180.00\" type=\"car\" speed=\"4.00\" pos=\"4.00\" lane=\"f_0\" slope=\"0.00\"/>\n"
+  "    </timestep>\n"
+  "    <timestep time=\"3.00\">\n"
+  "    </timestep>\n"
+  "</fcd-export>\n";
+
+// This test converts a fcd output and checks the time steps, the records and the departed and arrived vehicles of the
+// mapped trace.
+class FcdTraceConversionTestCase : public TestCase
+{
+public:
+  FcdTraceConversionTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+FcdTraceConversionTestCase::FcdTraceConversionTestCase ()
+  : TestCase ("Convert a fcd output and read the mapped trace")
+{
+}
+
+void
+FcdTraceConversionTestCase::DoRun (void)
+{
+  std::string xmlPath = CreateTempDirFilename ("fcd.xml");
+  std::string binaryPath = CreateTempDirFilename ("fcd.bin");
+  std::ofstream (xmlPath) << g_fcdOutput;
+
+  FcdTrace::ConvertFromXml (xmlPath, binaryPath);
+  Ptr<FcdTrace> trace = Create<FcdTrace> (binaryPath);
+
+  NS_TEST_ASSERT_MSG_EQ (trace->GetNumFrames (), 4, "Wrong number of time steps");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetNumVehicles (), 3, "Wrong number of vehicles");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrame (3).numRecords, 0, "The last time step has no vehicles");
+
+  NS_TEST_ASSERT_MSG_EQ (trace->FindFrame (-0.5), -1, "No time step before the start of the trace");
+  NS_TEST_ASSERT_MSG_EQ (trace->FindFrame (0), 0, "Wrong time step");
+  NS_TEST_ASSERT_MSG_EQ (trace->FindFrame (1.9999999), 2, "The time steps are rounded");
+  NS_TEST_ASSERT_MSG_EQ (trace->FindFrame (1.5), 1, "Wrong time step");
+  NS_TEST_ASSERT_MSG_EQ (trace->FindFrame (100), 3, "The last time step holds after the end of the trace");
+
+  uint32_t veh2;
+  NS_TEST_ASSERT_MSG_EQ (trace->GetVehicleIndex ("veh2", veh2), true, "veh2 is in the trace");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetVehicleId (veh2), "veh2", "Wrong vehicle id");
+  uint32_t unknown;
+  NS_TEST_ASSERT_MSG_EQ (trace->GetVehicleIndex ("veh3", unknown), false, "veh3 is not in the trace");
+
+  const FcdTrace::Record* record = trace->FindRecord (2, veh2);
+  NS_TEST_ASSERT_MSG_NE (record, 0, "veh2 is in the third time step");
+  NS_TEST_ASSERT_MSG_EQ (record->x, -3.5, "Wrong x");
+  NS_TEST_ASSERT_MSG_EQ (record->y, -4.0, "Wrong y");
+  NS_TEST_ASSERT_MSG_EQ (record->speed, 4.0, "Wrong speed");
+  NS_TEST_ASSERT_MSG_EQ (record->angle, 180.0, "Wrong angle");
+  NS_TEST_ASSERT_MSG_EQ (trace->FindRecord (0, veh2), 0, "veh2 is not in the first time step");
+
+  uint32_t veh1;
+  trace->GetVehicleIndex ("veh1", veh1);
+  NS_TEST_ASSERT_MSG_EQ (trace->FindRecord (1, veh1)->y, 7.0, "A tag spanning two lines is parsed");
+
+  std::vector<std::string> departed;
+  std::vector<std::string> arrived;
+  trace->GetChanges (-1, 0, departed, arrived);
+  NS_TEST_ASSERT_MSG_EQ (departed.size (), 2, "veh0 and veh1 depart at the start");
+  NS_TEST_ASSERT_MSG_EQ (arrived.size (), 0, "No vehicle arrives at the start");
+
+  trace->GetChanges (0, 2, departed, arrived);
+  NS_TEST_ASSERT_MSG_EQ (departed.size (), 1, "Only veh2 departs");
+  NS_TEST_ASSERT_MSG_EQ (departed[0], "veh2", "Only veh2 departs");
+  NS_TEST_ASSERT_MSG_EQ (arrived.size (), 1, "Only veh1 arrives");
+  NS_TEST_ASSERT_MSG_EQ (arrived[0], "veh1", "Only veh1 arrives");
+
+  trace->GetChanges (2, 3, departed, arrived);
+  NS_TEST_ASSERT_MSG_EQ (departed.size (), 0, "No vehicle departs at the end");
+  NS_TEST_ASSERT_MSG_EQ (arrived.size (), 2, "veh0 and veh2 arrive at the end");
+}
+
+// This test replays a converted fcd output with the TraciClient and checks the included and excluded nodes and their
+// positions.
+class FcdTraceReplayTestCase : public TestCase
+{
+public:
+  FcdTraceReplayTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckPositions (Ptr<TraciClient> client, uint32_t numVehicles, double veh0X);
+
+  NodeContainer m_nodePool;
+  uint32_t m_included;
+  uint32_t m_excluded;
+};
+
+FcdTraceReplayTestCase::FcdTraceReplayTestCase ()
+  : TestCase ("Replay a fcd trace with the TraciClient"),
+    m_included (0),
+    m_excluded (0)
+{
+}
+
+void
+FcdTraceReplayTestCase::CheckPositions (Ptr<TraciClient> client, uint32_t numVehicles, double veh0X)
+{
+  NS_TEST_ASSERT_MSG_EQ (client->GetVehicleMapSize (), numVehicles, "Wrong number of vehicles at " << Simulator::Now ().GetSeconds ());
+  Ptr<Node> node = client->m_vehicleNodeMap.at ("veh0");
+  Vector position = node->GetObject<MobilityModel> ()->GetPosition ();
+  NS_TEST_ASSERT_MSG_EQ_TOL (position.x, veh0X, 1e-9, "Wrong x of veh0 at " << Simulator::Now ().GetSeconds ());
+  NS_TEST_ASSERT_MSG_EQ_TOL (position.y, 20.0, 1e-9, "Wrong y of veh0");
+  NS_TEST_ASSERT_MSG_EQ_TOL (position.z, 1.5, 1e-9, "The altitude is set by the client");
+  NS_TEST_ASSERT_MSG_EQ (client->GetVehicleId (node), "veh0", "Wrong vehicle of the node");
+}
+
+void
+FcdTraceReplayTestCase::DoRun (void)
+{
+  std::string xmlPath = CreateTempDirFilename ("replay.xml");
+  std::string binaryPath = CreateTempDirFilename ("replay.bin");
+  std::ofstream (xmlPath) << g_fcdOutput;
+  FcdTrace::ConvertFromXml (xmlPath, binaryPath);
+
+  m_nodePool.Create (4);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantVelocityMobilityModel");
+  mobility.Install (m_nodePool);
+
+  Ptr<TraciClient> client = CreateObject<TraciClient> ();
+  client->SetAttribute ("FcdTracePath", StringValue (binaryPath));
+  client->SetAttribute ("SynchInterval", TimeValue (Seconds (1.0)));
+  client->SetAttribute ("MobilityUpdate", StringValue ("Linear"));
+
+  std::function<Ptr<Node> ()> includeNode = [this] () { return m_nodePool.Get (m_included++); };
+  std::function<void (Ptr<Node>)> excludeNode = [this, client] (Ptr<Node> node)
+    {
+      NS_TEST_EXPECT_MSG_NE (client->GetVehicleId (node), "", "The vehicle of an excluded node is still known");
+      m_excluded++;
+    };
+  client->SumoSetup (includeNode, excludeNode);
+
+  // the setup reads the trace at 0 s, then the client is one synch interval ahead: at 1 s it reads the trace at 2 s,
+  // and veh0 moves linearly from its position at 0 s to the one at 2 s
+  Simulator::Schedule (Seconds (1.5), &FcdTraceReplayTestCase::CheckPositions, this, client, 2, 20.0);
+  Simulator::Stop (Seconds (1.9));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_included, 3, "Every vehicle of the trace is included");
+  NS_TEST_ASSERT_MSG_EQ (m_excluded, 1, "veh1 is excluded");
+
+  Simulator::Stop (Seconds (1.0));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (client->GetVehicleMapSize (), 0, "All vehicles have arrived at the end of the trace");
+  NS_TEST_ASSERT_MSG_EQ (m_excluded, 3, "All vehicles are excluded");
+  NS_TEST_ASSERT_MSG_EQ (client->GetVehicleId (m_nodePool.Get (0)), "", "An excluded node has no vehicle");
+
+  client->SumoStop ();
+  Simulator::Destroy ();
+}
+
+class FcdTraceTestSuite : public TestSuite
+{
+public:
+  FcdTraceTestSuite ();
+};
+
+FcdTraceTestSuite::FcdTraceTestSuite ()
+  : TestSuite ("traci-fcd-trace", UNIT)
+{
+  AddTestCase (new FcdTraceConversionTestCase, TestCase::QUICK);
+  AddTestCase (new FcdTraceReplayTestCase, TestCase::QUICK);
+}
+
+static FcdTraceTestSuite fcdTraceTestSuite;